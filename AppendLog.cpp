@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AppendLog.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  AppendLog; portable
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include "AppendLog.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// A queued record, allocated with its data immediately after. Sequence zero
+// marks the end of the log.
+
+struct AppendLog::Record
+{
+  Record*  next;
+  uint64_t sequence;
+  size_t   bytes;
+
+  std::byte* GetData() {
+    return reinterpret_cast<std::byte*>( this + 1 );
+  }
+
+  static Record* Allocate( uint64_t sequence, const void* pData, size_t bytes )
+  {
+    auto pRecord = new( ::operator new( sizeof( Record ) + bytes ) ) Record{ nullptr, sequence, bytes };
+    if( bytes > 0 )
+      std::memcpy( pRecord->GetData(), pData, bytes );
+    return pRecord;
+  }
+
+  static void Free( Record* pRecord )
+  {
+    pRecord->~Record();
+    ::operator delete( pRecord );
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor/dtor
+
+AppendLog::AppendLog() :
+  file_(),
+  maxDelay_( 0 ),
+  thread_(),
+  head_( nullptr ),
+  nextSequence_( 0u ),
+  isAccepting_( false ),
+  batch_(),
+  buffer_(),
+  mutex_(),
+  committedChanged_(),
+  durable_(),
+  committed_( 0u ),
+  hasError_( false )
+{
+}
+
+AppendLog::~AppendLog()
+{
+  Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Open for appending; readers may tail the log while it's written
+
+bool AppendLog::Open( const fs::path& path, std::chrono::microseconds maxDelay )
+{
+  Close();
+  file_.SetFile( path );
+  if( !file_.Create( FileFlags::Write | FileFlags::Append | FileFlags::SharedRead ) )
+    return false;
+
+  maxDelay_ = maxDelay;
+  nextSequence_ = 0u;
+  durable_ = MinHeap();
+  committed_ = 0u;
+  hasError_ = false;
+  isAccepting_ = true;
+  thread_ = std::thread( &AppendLog::FlushThread, this );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The end marker is committed after everything queued before it
+
+void AppendLog::Close()
+{
+  if( !thread_.joinable() )
+    return;
+  isAccepting_ = false;
+  auto pEnd = Record::Allocate( 0u, nullptr, 0u );
+  auto pHead = head_.load( std::memory_order_relaxed );
+  do
+  {
+    pEnd->next = pHead;
+  } while( !head_.compare_exchange_weak( pHead, pEnd, std::memory_order_release,
+                                         std::memory_order_relaxed ) );
+  head_.notify_one();
+  thread_.join();
+  file_.Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Push onto the queue. Only the push that makes the queue non-empty needs to
+// wake the flusher; later pushes join the same batch.
+
+uint64_t AppendLog::Append( const void* pData, size_t bytes )
+{
+  assert( pData != nullptr || bytes == 0 );
+  if( !isAccepting_.load( std::memory_order_relaxed ) )
+    return 0u;
+
+  auto sequence = nextSequence_.fetch_add( 1, std::memory_order_relaxed ) + 1;
+  auto pRecord = Record::Allocate( sequence, pData, bytes );
+  auto pHead = head_.load( std::memory_order_relaxed );
+  do
+  {
+    pRecord->next = pHead;
+  } while( !head_.compare_exchange_weak( pHead, pRecord, std::memory_order_release,
+                                         std::memory_order_relaxed ) );
+  if( pHead == nullptr )
+    head_.notify_one();
+  return sequence;
+}
+
+bool AppendLog::WaitForCommit( uint64_t sequence )
+{
+  // Zero is what Append returns for a record it dropped
+  if( sequence == 0 )
+    return false;
+  std::unique_lock lock( mutex_ );
+  committedChanged_.wait( lock, [&] { return committed_ >= sequence || hasError_; } );
+  return committed_ >= sequence;
+}
+
+uint64_t AppendLog::GetCommitted() const
+{
+  std::lock_guard lock( mutex_ );
+  return committed_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Wait for records, optionally linger so more can join, then take the whole
+// queue as one batch. Records arriving during the commit form the next batch.
+
+void AppendLog::FlushThread()
+{
+  for( ;; )
+  {
+    head_.wait( nullptr, std::memory_order_acquire );
+    if( maxDelay_.count() > 0 )
+      std::this_thread::sleep_for( maxDelay_ );
+    if( !Commit( head_.exchange( nullptr, std::memory_order_acquire ) ) )
+      return;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write and flush the batch, then advance the committed sequence past every
+// contiguous durable record. Returns false once the end marker is reached.
+
+bool AppendLog::Commit( Record* pBatch )
+{
+  batch_.clear();
+  for( ; pBatch != nullptr; pBatch = pBatch->next )
+    batch_.push_back( pBatch );
+  std::sort( batch_.begin(), batch_.end(), []( const Record* lhs, const Record* rhs )
+  {
+    return lhs->sequence < rhs->sequence;
+  } );
+
+  // The end marker sorts first
+  auto isEnd = !batch_.empty() && batch_.front()->sequence == 0;
+  buffer_.clear();
+  for( auto pRecord : batch_ )
+    buffer_.insert( buffer_.end(), pRecord->GetData(), pRecord->GetData() + pRecord->bytes );
+
+  auto success = buffer_.empty() || ( file_.Write( buffer_.data(), buffer_.size() ) && file_.Flush() );
+  {
+    std::lock_guard lock( mutex_ );
+    if( !success )
+      hasError_ = true;
+    for( auto pRecord : batch_ )
+    {
+      if( success && pRecord->sequence != 0 )
+        durable_.push( pRecord->sequence );
+      Record::Free( pRecord );
+    }
+    while( !durable_.empty() && durable_.top() == committed_ + 1 )
+    {
+      durable_.pop();
+      ++committed_;
+    }
+  }
+  committedChanged_.notify_all();
+  return !isEnd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
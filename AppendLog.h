@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AppendLog.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Append-only journal with group commit. Producers queue records without locks;
+//  a flusher thread writes each batch with one write and one flush, so the
+//  flush cost is shared by every record that arrived while the last one ran.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Records are written as given; framing, if any, is up to the caller. Within
+// a batch records are written in sequence order. A record appended while an
+// earlier one is still being queued on another thread may land in a later
+// batch, so file order across threads follows sequence order only loosely.
+//
+//   AppendLog log;
+//   log.Open( "journal.bin" );
+//   auto sequence = log.Append( &record, sizeof( record ) );
+//   if( !log.WaitForCommit( sequence ) )
+//     ...
+
+class AppendLog
+{
+public:
+
+  AppendLog();
+  ~AppendLog();
+
+  // Disable copy/move
+  AppendLog( const AppendLog& ) = delete;
+  AppendLog& operator=( const AppendLog& ) = delete;
+  AppendLog( AppendLog&& ) = delete;
+  AppendLog& operator=( AppendLog&& ) = delete;
+
+  // Open or create the log and start the flusher. maxDelay holds each batch
+  // open that long after its first record, trading latency for larger
+  // batches; zero commits as soon as the flusher is free.
+  bool Open( const std::filesystem::path&, 
+             std::chrono::microseconds maxDelay = std::chrono::microseconds( 0 ) );
+
+  // Commit everything queued and stop. Producers must have stopped.
+  void Close();
+
+  bool IsOpen() const {
+    return thread_.joinable();
+  }
+
+  // Queue a copy of the record. Lock-free; safe from any thread. Returns the
+  // record's sequence number, starting from 1, or 0 if the log isn't open.
+  uint64_t Append( const void*, size_t bytes );
+
+  // Block until every record up to and including sequence is durable.
+  // Returns false if a write or flush failed, or for sequence 0.
+  bool WaitForCommit( uint64_t sequence );
+
+  // Highest sequence number such that it and all before it are durable
+  uint64_t GetCommitted() const;
+
+private:
+
+  struct Record;
+
+  void FlushThread();
+  bool Commit( Record* batch );
+
+private:
+
+  using MinHeap = std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>>;
+
+  File                        file_;
+  std::chrono::microseconds   maxDelay_;
+  std::thread                 thread_;
+  std::atomic<Record*>        head_;         // queued records, newest first
+  std::atomic<uint64_t>       nextSequence_;
+  std::atomic<bool>           isAccepting_;
+
+  // Flusher thread only
+  std::vector<Record*>        batch_;
+  std::vector<std::byte>      buffer_;
+
+  // Commit state
+  mutable std::mutex          mutex_;
+  std::condition_variable     committedChanged_;
+  MinHeap                     durable_;      // committed out of sequence order
+  uint64_t                    committed_;
+  bool                        hasError_;
+
+}; // class AppendLog
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AtomicFileWriter.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include "AtomicFileWriter.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+// Hidden sibling of the target that no other writer will pick,
+// e.g. ".save.dat.81234567890-7.tmp"
+fs::path MakeTempPath( const fs::path& target )
+{
+  static std::atomic<uint32_t> sCounter = 0u;
+  auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+  fs::path name = ".";
+  name += target.filename();
+  name += "." + std::to_string( ticks ) + "-" + std::to_string( sCounter++ ) + ".tmp";
+  auto tempPath = target;
+  tempPath.replace_filename( name );
+  return tempPath;
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+AtomicFileWriter::AtomicFileWriter( const fs::path& target ) :
+  target_( target ),
+  temp_()
+{
+  assert( target.has_filename() );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor. Anything not committed is discarded.
+
+AtomicFileWriter::~AtomicFileWriter()
+{
+  Abort();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Create the temporary file, including any intermediate directories. The
+// target is untouched until Commit(). A non-zero expectedSize preallocates
+// the file so it's written contiguously.
+
+bool AtomicFileWriter::Open( FileFlags extraFlags, uint64_t expectedSize )
+{
+  Abort();
+  temp_.SetFile( MakeTempPath( target_ ) );
+  if( !temp_.Create( FileFlags::Write | extraFlags ) )
+    return false;
+
+  // Only a hint; writing still works without the reservation
+  if( expectedSize > 0 )
+    temp_.Reserve( expectedSize );
+  return true;
+}
+
+bool AtomicFileWriter::Write( const void* pBuffer, uint64_t bytes )
+{
+  assert( temp_.IsOpen() );
+  return temp_.Write( pBuffer, bytes );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Flush the temporary file to storage and swap it into place. This is the
+// only flush, so the data is durable once before the rename rather than
+// written twice. On failure the target is left as it was.
+
+bool AtomicFileWriter::Commit()
+{
+  assert( temp_.IsOpen() );
+  if( !temp_.IsOpen() )
+    return false;
+
+  auto isFlushed = temp_.Flush();
+  temp_.Close();
+  if( !isFlushed || !File::Replace( temp_.GetPath(), target_ ) )
+  {
+    Abort();
+    return false;
+  }
+  temp_.SetFile( fs::path() );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Close and delete the temporary file, if any
+
+void AtomicFileWriter::Abort()
+{
+  temp_.Close();
+  auto tempPath = temp_.GetPath();
+  if( !tempPath.empty() )
+  {
+    std::error_code ec;
+    fs::remove( tempPath, ec );
+    temp_.SetFile( fs::path() );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
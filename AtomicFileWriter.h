@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AtomicFileWriter.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Crash-safe file replacement. Data is written to a temporary file next to
+//  the target, flushed once, then swapped into place, so readers see either
+//  the complete old file or the complete new one.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  AtomicFileWriter writer( "save.dat" );
+//  if( writer.Open() && writer.Write( data, size ) )
+//    writer.Commit();
+
+class AtomicFileWriter
+{
+public:
+
+  explicit AtomicFileWriter( const std::filesystem::path& target );
+  ~AtomicFileWriter();
+
+  // Disable copy/move
+  AtomicFileWriter( const AtomicFileWriter& ) = delete;
+  AtomicFileWriter& operator=( const AtomicFileWriter& ) = delete;
+  AtomicFileWriter( AtomicFileWriter&& ) = delete;
+  AtomicFileWriter& operator=( AtomicFileWriter&& ) = delete;
+
+  bool Open( FileFlags extraFlags = FileFlags::SequentialScan, uint64_t expectedSize = 0 );
+  bool Write( const void*, uint64_t );
+  bool Commit();
+  void Abort();
+
+  // For writes beyond Write(), e.g. BufferedFileWriter or WriteAt
+  File& GetFile() {
+    return temp_;
+  }
+
+  std::filesystem::path GetTarget() const {
+    return target_;
+  }
+
+private:
+
+  std::filesystem::path target_;
+  File                  temp_;
+
+}; // class AtomicFileWriter
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
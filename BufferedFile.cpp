@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  BufferedFile.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include "BufferedFile.h"
+
+using namespace PKIsensee;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// BufferedFileReader
+
+BufferedFileReader::BufferedFileReader( const File& file, size_t bufferSize ) :
+  file_( file ),
+  bufferSize_( std::clamp<size_t>( bufferSize, 1u, std::numeric_limits<uint32_t>::max() ) ),
+  buffer_( std::make_unique_for_overwrite<std::byte[]>( bufferSize_ ) ),
+  pos_( 0u ),
+  end_( 0u )
+{
+  assert( file.IsOpen() );
+  assert( !( file.GetFlags() & FileFlags::Async ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copy from the buffer, refilling as needed. Requests at least as large as the
+// buffer bypass it once it's drained.
+
+bool BufferedFileReader::Read( void* pBuffer, size_t bytes )
+{
+  assert( pBuffer != nullptr || bytes == 0 );
+  auto pDest = static_cast<std::byte*>( pBuffer );
+  while( bytes > 0 )
+  {
+    if( pos_ == end_ )
+    {
+      if( bytes >= bufferSize_ )
+        return file_.Read( pDest, bytes );
+      if( !Fill() )
+        return false;
+    }
+    auto count = std::min( bytes, end_ - pos_ );
+    std::memcpy( pDest, buffer_.get() + pos_, count );
+    pos_ += count;
+    pDest += count;
+    bytes -= count;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read the next buffer's worth; false at end of file
+
+bool BufferedFileReader::Fill()
+{
+  uint32_t bytesRead = 0u;
+  auto success = file_.Read( buffer_.get(), static_cast<uint32_t>( bufferSize_ ), bytesRead );
+  pos_ = 0u;
+  end_ = success ? bytesRead : 0u;
+  return( end_ > 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// BufferedFileWriter
+
+BufferedFileWriter::BufferedFileWriter( File& file, size_t bufferSize ) :
+  file_( file ),
+  bufferSize_( std::max<size_t>( bufferSize, 1u ) ),
+  buffer_( std::make_unique_for_overwrite<std::byte[]>( bufferSize_ ) ),
+  used_( 0u )
+{
+  assert( file.IsOpen() );
+  assert( !( file.GetFlags() & FileFlags::Async ) );
+}
+
+BufferedFileWriter::~BufferedFileWriter()
+{
+  FlushBuffer();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Append to the buffer, writing it out when full. Requests at least as large
+// as the buffer are written directly after draining what's buffered.
+
+bool BufferedFileWriter::Write( const void* pBuffer, size_t bytes )
+{
+  assert( pBuffer != nullptr || bytes == 0 );
+  auto pSrc = static_cast<const std::byte*>( pBuffer );
+  if( bytes >= bufferSize_ )
+    return( FlushBuffer() && file_.Write( pSrc, bytes ) );
+
+  while( bytes > 0 )
+  {
+    if( used_ == bufferSize_ && !FlushBuffer() )
+      return false;
+    auto count = std::min( bytes, bufferSize_ - used_ );
+    std::memcpy( buffer_.get() + used_, pSrc, count );
+    used_ += count;
+    pSrc += count;
+    bytes -= count;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Hand buffered bytes to the OS. The data is safe from a process crash but not
+// from a system crash.
+
+bool BufferedFileWriter::FlushBuffer()
+{
+  if( used_ == 0 )
+    return true;
+  auto success = file_.Write( buffer_.get(), used_ );
+  used_ = 0u;
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write buffered bytes and flush the file to the storage medium
+
+bool BufferedFileWriter::Flush()
+{
+  return FlushBuffer() && file_.Flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
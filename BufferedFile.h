@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  BufferedFile.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Buffered reading and writing over File for streams of small records. Each
+//  native call moves a whole buffer, so per-field reads and writes cost a
+//  memcpy instead of a kernel transition.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Reads sequentially from the current position of an open File. The File must
+// not be read or repositioned by anyone else while the reader is in use.
+
+class BufferedFileReader
+{
+public:
+
+  explicit BufferedFileReader( const File&, size_t bufferSize = 64 * 1024 );
+
+  // Disable copy/move
+  BufferedFileReader( const BufferedFileReader& ) = delete;
+  BufferedFileReader& operator=( const BufferedFileReader& ) = delete;
+  BufferedFileReader( BufferedFileReader&& ) = delete;
+  BufferedFileReader& operator=( BufferedFileReader&& ) = delete;
+
+  // Returns false if fewer than bytes remain in the file
+  bool Read( void*, size_t bytes );
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  bool Read( T& value )
+  {
+    if( end_ - pos_ < sizeof( T ) )
+      return Read( &value, sizeof( T ) );
+    std::memcpy( &value, buffer_.get() + pos_, sizeof( T ) );
+    pos_ += sizeof( T );
+    return true;
+  }
+
+private:
+
+  bool Fill();
+
+private:
+
+  const File&                  file_;
+  size_t                       bufferSize_;
+  std::unique_ptr<std::byte[]> buffer_;
+  size_t                       pos_; // next unread byte
+  size_t                       end_; // one past the last valid byte
+
+}; // class BufferedFileReader
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Writes sequentially at the current position of an open File. Buffered data
+// is handed to the OS when the buffer fills, on FlushBuffer()/Flush(), and on
+// destruction. Only Flush() forces it to the storage medium.
+
+class BufferedFileWriter
+{
+public:
+
+  explicit BufferedFileWriter( File&, size_t bufferSize = 64 * 1024 );
+  ~BufferedFileWriter();
+
+  // Disable copy/move
+  BufferedFileWriter( const BufferedFileWriter& ) = delete;
+  BufferedFileWriter& operator=( const BufferedFileWriter& ) = delete;
+  BufferedFileWriter( BufferedFileWriter&& ) = delete;
+  BufferedFileWriter& operator=( BufferedFileWriter&& ) = delete;
+
+  bool Write( const void*, size_t bytes );
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  bool Write( const T& value )
+  {
+    if( bufferSize_ - used_ < sizeof( T ) )
+      return Write( &value, sizeof( T ) );
+    std::memcpy( buffer_.get() + used_, &value, sizeof( T ) );
+    used_ += sizeof( T );
+    return true;
+  }
+
+  bool FlushBuffer();
+  bool Flush();
+
+private:
+
+  File&                        file_;
+  size_t                       bufferSize_;
+  std::unique_ptr<std::byte[]> buffer_;
+  size_t                       used_;
+
+}; // class BufferedFileWriter
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,639 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  CompressedFile.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  CompressedFileWriter and CompressedFileReader; portable. Includes an LZ4 block
+//  format codec, so streams can also be decoded by the reference LZ4 library.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include "CompressedFile.h"
+#include "FileBatch.h"
+#include "Log.h"
+
+using namespace PKIsensee;
+
+namespace { // anonymous namespace
+
+static_assert( std::endian::native == std::endian::little, "on-disk fields are little-endian" );
+
+constexpr uint32_t kStreamMagic = 0x5A4C4B50; // "PKLZ"
+constexpr uint32_t kIndexMagic = 0x584C4B50;  // "PKLX"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kStoredRaw = 0x80000000;   // stored size flag
+constexpr uint32_t kMinBlockSize = 4 * 1024;
+constexpr uint32_t kMaxBlockSize = 64 * 1024 * 1024;
+constexpr uint64_t kMaxReadBatch = 16 * 1024 * 1024; // compressed bytes per parallel read
+
+struct StreamHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t blockSize;
+  uint32_t reserved;
+};
+
+struct BlockHeader
+{
+  uint32_t storedSize;
+  uint32_t rawSize;
+};
+
+struct StreamTrailer
+{
+  uint64_t indexOffset;
+  uint64_t rawLength;
+  uint32_t blockCount;
+  uint32_t magic;
+};
+
+static_assert( sizeof( StreamHeader ) == 16 );
+static_assert( sizeof( BlockHeader ) == 8 );
+static_assert( sizeof( StreamTrailer ) == 24 );
+static_assert( sizeof( CompressedBlock ) == 16 );
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ4 block format. A greedy single-probe matcher over a 4K-entry hash table,
+// as in the reference "fast" mode, that skips ahead faster the longer it goes
+// without finding a match. The end-of-block rules are honored: the last match
+// starts at least 12 bytes before the end, and the last 5 bytes are literals.
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMatchStartLimit = 12;
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMaxOffset = 65535;
+constexpr uint32_t kHashBits = 12;
+constexpr uint32_t kSkipShift = 6;
+
+constexpr size_t CompressBound( size_t bytes )
+{
+  return bytes + bytes / 255 + 16;
+}
+
+template <typename T>
+T Load( const std::byte* p )
+{
+  T value;
+  std::memcpy( &value, p, sizeof( value ) );
+  return value;
+}
+
+uint32_t HashOf( const std::byte* p )
+{
+  return ( Load<uint32_t>( p ) * 2654435761u ) >> ( 32 - kHashBits );
+}
+
+// Number of equal bytes at p and match, stopping at pEnd
+size_t MatchLength( const std::byte* p, const std::byte* match, const std::byte* pEnd )
+{
+  auto pStart = p;
+  while( pEnd - p >= 8 )
+  {
+    auto diff = Load<uint64_t>( p ) ^ Load<uint64_t>( match );
+    if( diff != 0 )
+      return size_t( p - pStart ) + size_t( std::countr_zero( diff ) / 8 );
+    p += 8;
+    match += 8;
+  }
+  while( p < pEnd && *p == *match )
+  {
+    ++p;
+    ++match;
+  }
+  return size_t( p - pStart );
+}
+
+std::byte* WriteLength( std::byte* out, size_t length )
+{
+  for( length -= 15; length >= 255; length -= 255 )
+    *out++ = std::byte( 255 );
+  *out++ = std::byte( length );
+  return out;
+}
+
+std::byte* WriteSequence( std::byte* out, const std::byte* literals, size_t literalLength,
+                          size_t offset, size_t matchLength )
+{
+  auto token = out++;
+  *token = std::byte( std::min<size_t>( literalLength, 15 ) << 4 );
+  if( literalLength >= 15 )
+    out = WriteLength( out, literalLength );
+  if( literalLength > 0 )
+    std::memcpy( out, literals, literalLength );
+  out += literalLength;
+  if( matchLength == 0 ) // last sequence
+    return out;
+
+  *out++ = std::byte( offset & 0xFF );
+  *out++ = std::byte( offset >> 8 );
+  matchLength -= kMinMatch;
+  *token |= std::byte( std::min<size_t>( matchLength, 15 ) );
+  if( matchLength >= 15 )
+    out = WriteLength( out, matchLength );
+  return out;
+}
+
+// Compress into dst, which holds at least CompressBound( srcSize ) bytes.
+// Returns the compressed size.
+size_t Lz4Compress( const std::byte* src, size_t srcSize, std::byte* dst )
+{
+  auto out = dst;
+  auto anchor = src;
+  auto end = src + srcSize;
+  if( srcSize > kMatchStartLimit )
+  {
+    std::array<uint32_t, 1u << kHashBits> table = {}; // positions; 0 is src itself
+    auto limit = end - kMatchStartLimit;
+    auto matchEnd = end - kLastLiterals;
+    auto ip = src + 1;
+    size_t attempts = 1u << kSkipShift;
+    while( ip <= limit )
+    {
+      auto hash = HashOf( ip );
+      auto match = src + table[ hash ];
+      table[ hash ] = static_cast<uint32_t>( ip - src );
+      if( size_t( ip - match ) > kMaxOffset || Load<uint32_t>( match ) != Load<uint32_t>( ip ) )
+      {
+        ip += attempts++ >> kSkipShift;
+        continue;
+      }
+      attempts = 1u << kSkipShift;
+
+      while( ip > anchor && match > src && ip[ -1 ] == match[ -1 ] )
+      {
+        --ip;
+        --match;
+      }
+      auto length = kMinMatch + MatchLength( ip + kMinMatch, match + kMinMatch, matchEnd );
+      out = WriteSequence( out, anchor, size_t( ip - anchor ), size_t( ip - match ), length );
+      ip += length;
+      anchor = ip;
+      if( ip <= limit )
+        table[ HashOf( ip - 2 ) ] = static_cast<uint32_t>( ip - 2 - src );
+    }
+  }
+  out = WriteSequence( out, anchor, size_t( end - anchor ), 0u, 0u );
+  return size_t( out - dst );
+}
+
+// Read an extended length; false if the input runs out
+bool ReadLength( const std::byte*& ip, const std::byte* iEnd, size_t& length )
+{
+  for( ;; )
+  {
+    if( ip == iEnd )
+      return false;
+    auto extra = std::to_integer<size_t>( *ip++ );
+    length += extra;
+    if( extra != 255 )
+      return true;
+  }
+}
+
+// Decompress exactly dstSize bytes. Every length and offset is checked, so
+// corrupt input fails rather than reading or writing out of bounds.
+bool Lz4Decompress( const std::byte* src, size_t srcSize, std::byte* dst, size_t dstSize )
+{
+  auto ip = src;
+  auto iEnd = src + srcSize;
+  auto op = dst;
+  auto oEnd = dst + dstSize;
+  for( ;; )
+  {
+    if( ip == iEnd )
+      return false;
+    auto token = std::to_integer<size_t>( *ip++ );
+
+    auto literalLength = token >> 4;
+    if( literalLength == 15 && !ReadLength( ip, iEnd, literalLength ) )
+      return false;
+    if( literalLength > size_t( iEnd - ip ) || literalLength > size_t( oEnd - op ) )
+      return false;
+    if( literalLength > 0 )
+      std::memcpy( op, ip, literalLength );
+    ip += literalLength;
+    op += literalLength;
+    if( ip == iEnd )
+      return ( op == oEnd );
+
+    if( iEnd - ip < 2 )
+      return false;
+    auto offset = std::to_integer<size_t>( ip[ 0 ] ) | ( std::to_integer<size_t>( ip[ 1 ] ) << 8 );
+    ip += 2;
+    if( offset == 0 || offset > size_t( op - dst ) )
+      return false;
+
+    auto matchLength = token & 15;
+    if( matchLength == 15 && !ReadLength( ip, iEnd, matchLength ) )
+      return false;
+    matchLength += kMinMatch;
+    if( matchLength > size_t( oEnd - op ) )
+      return false;
+
+    // Overlapping matches repeat the last offset bytes
+    auto match = op - offset;
+    if( offset >= matchLength )
+    {
+      std::memcpy( op, match, matchLength );
+      op += matchLength;
+    }
+    else
+    {
+      for( auto opEnd = op + matchLength; op < opEnd; )
+        *op++ = *match++;
+    }
+  }
+}
+
+uint32_t ResolveThreadCount( uint32_t threadCount )
+{
+  return threadCount ? threadCount : std::max( std::thread::hardware_concurrency(), 1u );
+}
+
+uint32_t StoredBytes( const CompressedBlock& block )
+{
+  return block.storedSize & ~kStoredRaw;
+}
+
+uint64_t BlockEnd( const CompressedBlock& block )
+{
+  return block.offset + sizeof( BlockHeader ) + StoredBytes( block );
+}
+
+// Sizes a decoder can trust: raw blocks store exactly rawSize bytes
+bool IsValidBlock( const CompressedBlock& block, uint32_t blockSize )
+{
+  if( block.rawSize == 0 || block.rawSize > blockSize )
+    return false;
+  if( block.storedSize & kStoredRaw )
+    return( StoredBytes( block ) == block.rawSize );
+  return( StoredBytes( block ) <= CompressBound( blockSize ) );
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CompressedFileWriter. A batch holds one block per thread so every thread
+// has a block to compress.
+
+CompressedFileWriter::CompressedFileWriter( File& file, uint32_t blockSize, uint32_t threadCount ) :
+  file_( file ),
+  blockSize_( std::clamp( blockSize, kMinBlockSize, kMaxBlockSize ) ),
+  threadCount_( ResolveThreadCount( threadCount ) ),
+  pending_(),
+  compressed_( threadCount_ ),
+  output_(),
+  index_(),
+  offset_( 0u ),
+  rawLength_( 0u ),
+  isFinished_( false ),
+  hasError_( false )
+{
+  assert( file.IsOpen() );
+  assert( !( file.GetFlags() & FileFlags::Async ) );
+  pending_.reserve( size_t( blockSize_ ) * threadCount_ );
+}
+
+CompressedFileWriter::~CompressedFileWriter()
+{
+  Finish();
+}
+
+bool CompressedFileWriter::Write( const void* pBuffer, size_t bytes )
+{
+  assert( pBuffer != nullptr || bytes == 0 );
+  assert( !isFinished_ );
+  if( isFinished_ || hasError_ )
+    return false;
+
+  auto pSrc = static_cast<const std::byte*>( pBuffer );
+  auto capacity = size_t( blockSize_ ) * threadCount_;
+  while( bytes > 0 )
+  {
+    auto count = std::min( bytes, capacity - pending_.size() );
+    pending_.insert( pending_.end(), pSrc, pSrc + count );
+    pSrc += count;
+    bytes -= count;
+    if( pending_.size() == capacity && !WriteBatch() )
+      return false;
+  }
+  return true;
+}
+
+bool CompressedFileWriter::FlushBuffer()
+{
+  if( !pending_.empty() )
+    WriteBatch();
+  return !hasError_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write the index and trailer after the last block
+
+bool CompressedFileWriter::Finish()
+{
+  if( isFinished_ )
+    return !hasError_;
+  isFinished_ = true;
+  if( hasError_ || !FlushBuffer() || ( offset_ == 0 && !WriteHeader() ) )
+    return false;
+
+  StreamTrailer trailer = { offset_, rawLength_, static_cast<uint32_t>( index_.size() ), 
+                            kIndexMagic };
+  auto indexBytes = index_.size() * sizeof( CompressedBlock );
+  if( ( indexBytes > 0 && !file_.Write( index_.data(), indexBytes ) ) || 
+      !file_.Write( &trailer, sizeof( trailer ) ) )
+  {
+    hasError_ = true;
+    return false;
+  }
+  offset_ += indexBytes + sizeof( trailer );
+  return true;
+}
+
+bool CompressedFileWriter::WriteHeader()
+{
+  StreamHeader header = { kStreamMagic, kVersion, blockSize_, 0u };
+  if( !file_.Write( &header, sizeof( header ) ) )
+  {
+    hasError_ = true;
+    return false;
+  }
+  offset_ = sizeof( header );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Compress the pending blocks in parallel, then write them in order with a
+// single call. Blocks that don't shrink are stored as is.
+
+bool CompressedFileWriter::WriteBatch()
+{
+  if( offset_ == 0 && !WriteHeader() )
+    return false;
+
+  auto blockCount = ( pending_.size() + blockSize_ - 1 ) / blockSize_;
+  auto rawSizeOf = [&]( size_t i )
+  {
+    return std::min<size_t>( blockSize_, pending_.size() - i * blockSize_ );
+  };
+  FileBatch::ForEach( blockCount, threadCount_, [&]( size_t i )
+  {
+    auto& compressed = compressed_[ i ];
+    auto rawSize = rawSizeOf( i );
+    compressed.resize( CompressBound( rawSize ) );
+    auto size = Lz4Compress( pending_.data() + i * blockSize_, rawSize, compressed.data() );
+    compressed.resize( ( size < rawSize ) ? size : 0u );
+  } );
+
+  output_.clear();
+  for( size_t i = 0; i < blockCount; ++i )
+  {
+    auto rawSize = static_cast<uint32_t>( rawSizeOf( i ) );
+    auto pRaw = pending_.data() + i * blockSize_;
+    auto isRaw = compressed_[ i ].empty();
+    auto storedSize = isRaw ? rawSize : static_cast<uint32_t>( compressed_[ i ].size() );
+    BlockHeader header = { storedSize | ( isRaw ? kStoredRaw : 0u ), rawSize };
+
+    index_.push_back( { offset_ + output_.size(), header.storedSize, rawSize } );
+    auto pHeader = reinterpret_cast<const std::byte*>( &header );
+    output_.insert( output_.end(), pHeader, pHeader + sizeof( header ) );
+    auto pStored = isRaw ? pRaw : compressed_[ i ].data();
+    output_.insert( output_.end(), pStored, pStored + storedSize );
+  }
+
+  rawLength_ += pending_.size();
+  pending_.clear();
+  if( !file_.Write( output_.data(), output_.size() ) )
+  {
+    hasError_ = true;
+    return false;
+  }
+  offset_ += output_.size();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CompressedFileReader
+
+CompressedFileReader::CompressedFileReader( const File& file, uint32_t threadCount ) :
+  file_( file ),
+  threadCount_( ResolveThreadCount( threadCount ) ),
+  blockSize_( 0u ),
+  blocks_(),
+  rawStarts_( 1, 0u ),
+  compressed_(),
+  cache_(),
+  cachedBlock_( kNoBlock ),
+  pos_( 0u ),
+  isValid_( false )
+{
+  assert( file.IsOpen() );
+  assert( !( file.GetFlags() & FileFlags::Async ) );
+  isValid_ = ReadIndex();
+  if( !isValid_ )
+  {
+    blocks_.clear();
+    rawStarts_.assign( 1, 0u );
+  }
+}
+
+bool CompressedFileReader::SetPos( uint64_t pos )
+{
+  if( pos > GetLength() )
+    return false;
+  pos_ = pos;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Runs of whole blocks are decoded directly into the destination; the first
+// or last block of a read that only partly covers it comes from the cache
+
+bool CompressedFileReader::Read( void* pBuffer, size_t bytes )
+{
+  assert( pBuffer != nullptr || bytes == 0 );
+  if( !isValid_ || bytes > GetLength() - pos_ )
+    return false;
+
+  auto pDest = static_cast<std::byte*>( pBuffer );
+  while( bytes > 0 )
+  {
+    auto block = size_t( std::upper_bound( rawStarts_.begin(), rawStarts_.end(), pos_ ) - 
+                         rawStarts_.begin() ) - 1;
+    auto blockStart = rawStarts_[ block ];
+    size_t count = 0u;
+    if( pos_ == blockStart && bytes >= blocks_[ block ].rawSize && block != cachedBlock_ )
+    {
+      auto last = block + 1;
+      while( last < blocks_.size() && rawStarts_[ last + 1 ] - pos_ <= bytes &&
+             BlockEnd( blocks_[ last ] ) - blocks_[ block ].offset <= kMaxReadBatch )
+        ++last;
+      if( !DecodeBlocks( block, last, pDest ) )
+        return false;
+      count = static_cast<size_t>( rawStarts_[ last ] - pos_ );
+    }
+    else
+    {
+      if( !LoadBlock( block ) )
+        return false;
+      auto within = static_cast<size_t>( pos_ - blockStart );
+      count = std::min( bytes, cache_.size() - within );
+      std::memcpy( pDest, cache_.data() + within, count );
+    }
+    pDest += count;
+    pos_ += count;
+    bytes -= count;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Load the index named by the trailer, falling back to walking the blocks
+
+bool CompressedFileReader::ReadIndex()
+{
+  auto fileLength = file_.GetLength();
+  StreamHeader header = {};
+  if( fileLength < sizeof( header ) || !file_.ReadAt( 0u, &header, sizeof( header ) ) )
+    return false;
+  if( header.magic != kStreamMagic || header.version != kVersion || 
+      header.blockSize < kMinBlockSize || header.blockSize > kMaxBlockSize )
+  {
+    PKLOG_WARN( "%s is not a compressed stream\n", file_.GetPath().string().c_str() );
+    return false;
+  }
+  blockSize_ = header.blockSize;
+
+  StreamTrailer trailer = {};
+  if( fileLength < sizeof( header ) + sizeof( trailer ) || 
+      !file_.ReadAt( fileLength - sizeof( trailer ), &trailer, sizeof( trailer ) ) ||
+      trailer.magic != kIndexMagic || trailer.indexOffset < sizeof( header ) ||
+      trailer.indexOffset + uint64_t( trailer.blockCount ) * sizeof( CompressedBlock ) + 
+        sizeof( trailer ) != fileLength )
+    return RecoverIndex( fileLength );
+
+  auto indexBytes = uint64_t( trailer.blockCount ) * sizeof( CompressedBlock );
+  if( indexBytes > std::numeric_limits<uint32_t>::max() )
+    return false;
+  blocks_.resize( trailer.blockCount );
+  if( indexBytes > 0 && 
+      !file_.ReadAt( trailer.indexOffset, blocks_.data(), static_cast<uint32_t>( indexBytes ) ) )
+    return false;
+
+  rawStarts_.clear();
+  rawStarts_.reserve( blocks_.size() + 1 );
+  uint64_t rawLength = 0u;
+  uint64_t nextOffset = sizeof( header );
+  for( const auto& block : blocks_ )
+  {
+    // Blocks must be contiguous and in order; DecodeBlocks relies on it
+    if( !IsValidBlock( block, blockSize_ ) || block.offset != nextOffset ||
+        BlockEnd( block ) > trailer.indexOffset )
+    {
+      PKLOG_WARN( "%s has a corrupt block index\n", file_.GetPath().string().c_str() );
+      return false;
+    }
+    rawStarts_.push_back( rawLength );
+    rawLength += block.rawSize;
+    nextOffset = BlockEnd( block );
+  }
+  rawStarts_.push_back( rawLength );
+  return ( rawLength == trailer.rawLength );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Rebuild the index of a stream whose writer didn't finish. Stops at the first
+// block that is incomplete or doesn't look like a block.
+
+bool CompressedFileReader::RecoverIndex( uint64_t fileLength )
+{
+  PKLOG_WARN( "%s has no block index; recovering\n", file_.GetPath().string().c_str() );
+  blocks_.clear();
+  rawStarts_.assign( 1, 0u );
+  uint64_t offset = sizeof( StreamHeader );
+  for( ;; )
+  {
+    BlockHeader header = {};
+    if( fileLength - offset < sizeof( header ) || !file_.ReadAt( offset, &header, sizeof( header ) ) )
+      break;
+    CompressedBlock block = { offset, header.storedSize, header.rawSize };
+    if( !IsValidBlock( block, blockSize_ ) || BlockEnd( block ) > fileLength )
+      break;
+    blocks_.push_back( block );
+    rawStarts_.push_back( rawStarts_.back() + block.rawSize );
+    offset = BlockEnd( block );
+  }
+  return true;
+}
+
+bool CompressedFileReader::LoadBlock( size_t block )
+{
+  if( block == cachedBlock_ )
+    return true;
+  cachedBlock_ = kNoBlock;
+  cache_.resize( blocks_[ block ].rawSize );
+  if( !DecodeBlocks( block, block + 1, cache_.data() ) )
+    return false;
+  cachedBlock_ = block;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read blocks [first, last), which are contiguous in the file, with one call
+// and decompress them into pDest in parallel
+
+bool CompressedFileReader::DecodeBlocks( size_t first, size_t last, std::byte* pDest )
+{
+  auto start = blocks_[ first ].offset;
+  auto bytes = BlockEnd( blocks_[ last - 1 ] ) - start;
+  if( compressed_.size() < bytes )
+    compressed_.resize( static_cast<size_t>( bytes ) );
+  if( !file_.ReadAt( start, compressed_.data(), static_cast<uint32_t>( bytes ) ) )
+    return false;
+
+  std::atomic<bool> success = true;
+  FileBatch::ForEach( last - first, threadCount_, [&]( size_t i )
+  {
+    const auto& block = blocks_[ first + i ];
+    auto pStored = compressed_.data() + ( block.offset - start ) + sizeof( BlockHeader );
+    auto pRaw = pDest + ( rawStarts_[ first + i ] - rawStarts_[ first ] );
+    auto header = Load<BlockHeader>( pStored - sizeof( BlockHeader ) );
+    auto isValid = ( header.storedSize == block.storedSize && header.rawSize == block.rawSize );
+    if( isValid && ( block.storedSize & kStoredRaw ) )
+      std::memcpy( pRaw, pStored, block.rawSize );
+    else if( !isValid || !Lz4Decompress( pStored, StoredBytes( block ), pRaw, block.rawSize ) )
+      success = false;
+  } );
+  if( !success )
+    PKLOG_WARN( "%s has a corrupt block\n", file_.GetPath().string().c_str() );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  CompressedFile.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Block-compressed streams over File. Data is cut into blocks, each compressed
+//  independently in LZ4 block format, followed by an index of the blocks. Readers
+//  seek by decompressing a single block, and blocks are compressed and
+//  decompressed in parallel across cores.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Layout, all fields little-endian:
+//
+//   header    magic, version, block size
+//   blocks    { stored size, raw size } then the payload; the top bit of the
+//             stored size marks a block kept uncompressed
+//   index     one CompressedBlock per block
+//   trailer   index offset, raw length, block count, magic
+//
+// A stream whose writer never finished has no index; the reader recovers it
+// by walking the block headers, so a truncated log loses only its last block.
+
+struct CompressedBlock
+{
+  uint64_t offset;     // file offset of the block header
+  uint32_t storedSize; // payload bytes, plus the uncompressed flag
+  uint32_t rawSize;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Writes a compressed stream from the current position of an open File, which
+// should be the start of the file. Blocks are compressed a batch at a time,
+// one per thread; zero threads uses one per hardware thread. Finish() writes
+// the index and is called on destruction if needed.
+
+class CompressedFileWriter
+{
+public:
+
+  explicit CompressedFileWriter( File&, uint32_t blockSize = 256 * 1024, 
+                                 uint32_t threadCount = 0 );
+  ~CompressedFileWriter();
+
+  // Disable copy/move
+  CompressedFileWriter( const CompressedFileWriter& ) = delete;
+  CompressedFileWriter& operator=( const CompressedFileWriter& ) = delete;
+  CompressedFileWriter( CompressedFileWriter&& ) = delete;
+  CompressedFileWriter& operator=( CompressedFileWriter&& ) = delete;
+
+  bool Write( const void*, size_t bytes );
+
+  // Compress and write everything buffered so far, ending the current block
+  // early if necessary. Frequent calls cost compression ratio.
+  bool FlushBuffer();
+
+  // Write remaining data and the index. Nothing may be written afterwards.
+  bool Finish();
+
+private:
+
+  bool WriteHeader();
+  bool WriteBatch();
+
+private:
+
+  File&                               file_;
+  uint32_t                            blockSize_;
+  uint32_t                            threadCount_;
+  std::vector<std::byte>              pending_;     // raw data for the batch
+  std::vector<std::vector<std::byte>> compressed_;  // one per block in the batch
+  std::vector<std::byte>              output_;      // batch as written
+  std::vector<CompressedBlock>        index_;
+  uint64_t                            offset_;      // bytes written to the file
+  uint64_t                            rawLength_;
+  bool                                isFinished_;
+  bool                                hasError_;
+
+}; // class CompressedFileWriter
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Reads a compressed stream from an open, non-Async File. The index is loaded
+// by the constructor; check IsValid() before reading. Reads covering whole
+// blocks decompress them straight into the caller's buffer across threads;
+// partial blocks go through a one-block cache.
+
+class CompressedFileReader
+{
+public:
+
+  explicit CompressedFileReader( const File&, uint32_t threadCount = 0 );
+
+  // Disable copy/move
+  CompressedFileReader( const CompressedFileReader& ) = delete;
+  CompressedFileReader& operator=( const CompressedFileReader& ) = delete;
+  CompressedFileReader( CompressedFileReader&& ) = delete;
+  CompressedFileReader& operator=( CompressedFileReader&& ) = delete;
+
+  bool IsValid() const {
+    return isValid_;
+  }
+
+  // Uncompressed length and position
+  uint64_t GetLength() const {
+    return rawStarts_.back();
+  }
+
+  uint64_t GetPos() const {
+    return pos_;
+  }
+
+  // Returns false beyond the end of the stream
+  bool SetPos( uint64_t );
+
+  // Returns false if fewer than bytes remain
+  bool Read( void*, size_t bytes );
+
+  const std::vector<CompressedBlock>& GetIndex() const {
+    return blocks_;
+  }
+
+private:
+
+  bool ReadIndex();
+  bool RecoverIndex( uint64_t fileLength );
+  bool LoadBlock( size_t block );
+  bool DecodeBlocks( size_t first, size_t last, std::byte* pDest );
+
+private:
+
+  static constexpr size_t kNoBlock = std::numeric_limits<size_t>::max();
+
+  const File&                  file_;
+  uint32_t                     threadCount_;
+  uint32_t                     blockSize_;
+  std::vector<CompressedBlock> blocks_;
+  std::vector<uint64_t>        rawStarts_;  // per block, then the total length
+  std::vector<std::byte>       compressed_; // staging for reads
+  std::vector<std::byte>       cache_;      // contents of cachedBlock_
+  size_t                       cachedBlock_;
+  uint64_t                     pos_;
+  bool                         isValid_;
+
+}; // class CompressedFileReader
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
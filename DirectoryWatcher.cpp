@@ -0,0 +1,244 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryWatcher.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  *** Microsoft Windows implementation ***
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include "DirectoryWatcher.h"
+#include "Log.h"
+
+// Windows headers
+#define NOMINMAX 1
+#include "Windows.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+// Largest buffer ReadDirectoryChangesW accepts for network shares
+constexpr DWORD kBufferSize = 64 * 1024;
+
+constexpr DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                FILE_NOTIFY_CHANGE_CREATION;
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+DirectoryWatcher::DirectoryWatcher() :
+  root_(),
+  dir_(),
+  isRecursive_( false ),
+  callback_(),
+  latency_(),
+  thread_(),
+  stop_( NULL ),
+  notify_( nullptr ),
+  pending_(),
+  pendingIndex_(),
+  firstPending_()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+  Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Open the directory for overlapped change notifications and start the
+// watcher thread. The directory may be renamed or deleted while watched.
+
+bool DirectoryWatcher::Start( const fs::path& dir, bool isRecursive, Callback callback,
+                              std::chrono::milliseconds latency )
+{
+  Stop();
+  root_ = dir;
+  root_.make_preferred();
+
+  // No filename opens the directory itself
+  dir_.SetFile( root_ / L"" );
+  if( !dir_.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SharedWrite |
+                  FileFlags::SharedDelete | FileFlags::Async ) )
+    return false;
+
+  stop_ = ::CreateEventW( NULL, TRUE, FALSE, NULL );
+  if( stop_ == NULL )
+  {
+    PKLOG_WARN( "CreateEventW failed with error %d\n", ::GetLastError() );
+    dir_.Close();
+    return false;
+  }
+
+  isRecursive_ = isRecursive;
+  callback_ = std::move( callback );
+  latency_ = latency;
+  thread_ = std::thread( &DirectoryWatcher::WatchThread, this );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Stop watching and wait for the watcher thread to exit
+
+void DirectoryWatcher::Stop()
+{
+  if( thread_.joinable() )
+  {
+    ::SetEvent( stop_ );
+    thread_.join();
+  }
+  if( stop_ != NULL )
+  {
+    ::CloseHandle( stop_ );
+    stop_ = NULL;
+  }
+  dir_.Close();
+  pending_.clear();
+  pendingIndex_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Keep one ReadDirectoryChangesW outstanding, converting each batch of
+// notifications into events, until stopped. The next read is issued before
+// the batch is delivered, so changes during the callback aren't lost.
+
+void DirectoryWatcher::WatchThread()
+{
+  // Notifications are DWORD aligned
+  auto buffer = std::make_unique_for_overwrite<DWORD[]>( kBufferSize / sizeof( DWORD ) );
+  auto copy = std::make_unique_for_overwrite<DWORD[]>( kBufferSize / sizeof( DWORD ) );
+
+  OVERLAPPED overlapped = { 0 };
+  overlapped.hEvent = ::CreateEventW( NULL, TRUE, FALSE, NULL );
+  if( overlapped.hEvent == NULL )
+  {
+    PKLOG_WARN( "CreateEventW failed with error %d\n", ::GetLastError() );
+    return;
+  }
+
+  auto issue = [&]
+  {
+    auto success = ::ReadDirectoryChangesW( dir_.file_, buffer.get(), kBufferSize,
+                                            isRecursive_, kNotifyFilter, NULL, &overlapped, NULL );
+    if( !success )
+      PKLOG_WARN( "ReadDirectoryChangesW failed for %S with error %d\n", 
+                  root_.c_str(), ::GetLastError() );
+    return success == TRUE;
+  };
+
+  auto isIssued = issue();
+  auto isStopped = false;
+  while( isIssued )
+  {
+    auto timeout = GetTimeout();
+    DWORD waitMs = ( timeout == std::chrono::milliseconds::max() ) ? 
+                   INFINITE : static_cast<DWORD>( timeout.count() );
+    HANDLE handles[] = { overlapped.hEvent, stop_ };
+    auto wait = ::WaitForMultipleObjects( 2, handles, FALSE, waitMs );
+    if( wait == WAIT_TIMEOUT )
+    {
+      Deliver();
+      continue;
+    }
+    if( wait != WAIT_OBJECT_0 )
+    {
+      isStopped = true;
+      break;
+    }
+
+    DWORD bytes = 0u;
+    auto success = ::GetOverlappedResult( dir_.file_, &overlapped, &bytes, FALSE );
+    auto error = success ? ERROR_SUCCESS : ::GetLastError();
+    if( bytes > 0 )
+      std::memcpy( copy.get(), buffer.get(), bytes );
+
+    // The root itself is gone; nothing more will arrive
+    if( error == ERROR_ACCESS_DENIED )
+    {
+      Record( root_, Change::Removed );
+      isIssued = false;
+      break;
+    }
+    isIssued = issue();
+
+    // A zero-byte result means the buffer overflowed and changes were lost
+    if( bytes == 0 )
+    {
+      Record( root_, Change::Overflow );
+    }
+    else
+    {
+      auto pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>( copy.get() );
+      for( ;; )
+      {
+        std::wstring_view name( pInfo->FileName, pInfo->FileNameLength / sizeof( WCHAR ) );
+        switch( pInfo->Action )
+        {
+        case FILE_ACTION_ADDED:
+        case FILE_ACTION_RENAMED_NEW_NAME:
+          Record( root_ / name, Change::Added );
+          break;
+        case FILE_ACTION_REMOVED:
+        case FILE_ACTION_RENAMED_OLD_NAME:
+          Record( root_ / name, Change::Removed );
+          break;
+        case FILE_ACTION_MODIFIED:
+        default:
+          Record( root_ / name, Change::Modified );
+          break;
+        }
+        if( pInfo->NextEntryOffset == 0 )
+          break;
+        pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
+                  reinterpret_cast<const std::byte*>( pInfo ) + pInfo->NextEntryOffset );
+      }
+    }
+
+    if( GetTimeout().count() == 0 )
+      Deliver();
+  }
+
+  // Changes seen before a failure are still delivered
+  if( !isStopped )
+    Deliver();
+
+  if( isIssued )
+  {
+    DWORD bytes = 0u;
+    ::CancelIoEx( dir_.file_, &overlapped );
+    ::GetOverlappedResult( dir_.file_, &overlapped, &bytes, TRUE );
+  }
+  ::CloseHandle( overlapped.hEvent );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _WIN32
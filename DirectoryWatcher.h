@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryWatcher.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Pushes file system changes under a directory to a callback. Changes are
+//  collected for a short latency window and coalesced per path, so a burst
+//  of writes to one file arrives as a single Modified event.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class DirectoryWatcher
+{
+public:
+
+  enum class Change
+  {
+    Added,
+    Modified,
+    Removed,
+    Overflow, // changes were lost; path is the root, rescan it
+  };
+
+  struct Event
+  {
+    std::filesystem::path path; // root / relative path
+    Change                change;
+  };
+
+  // Invoked on the watcher thread with the coalesced events, in the order
+  // each path first changed
+  using Callback = std::function<void( std::span<const Event> )>;
+
+public:
+
+  DirectoryWatcher();
+  ~DirectoryWatcher();
+
+  // Disable copy/move
+  DirectoryWatcher( const DirectoryWatcher& ) = delete;
+  DirectoryWatcher& operator=( const DirectoryWatcher& ) = delete;
+  DirectoryWatcher( DirectoryWatcher&& ) = delete;
+  DirectoryWatcher& operator=( DirectoryWatcher&& ) = delete;
+
+  // Watch dir, and its subdirectories if recursive. Stops any current watch.
+  bool Start( const std::filesystem::path& dir, bool isRecursive, Callback,
+              std::chrono::milliseconds latency = std::chrono::milliseconds( 50 ) );
+
+  // Blocks until the callback isn't running; pending events are discarded
+  void Stop();
+
+  bool IsWatching() const {
+    return thread_.joinable();
+  }
+
+private:
+
+  struct PathHash
+  {
+    size_t operator()( const std::filesystem::path& path ) const {
+      return std::filesystem::hash_value( path );
+    }
+  };
+
+  void WatchThread();
+  void Record( const std::filesystem::path&, Change );
+  void Deliver();
+  std::chrono::milliseconds GetTimeout() const;
+
+private:
+
+  std::filesystem::path     root_;
+  File                      dir_;  // open directory; the watched handle on Windows
+  bool                      isRecursive_;
+  Callback                  callback_;
+  std::chrono::milliseconds latency_;
+  std::thread               thread_;
+  void*                     stop_;   // event HANDLE on Windows; eventfd on Linux
+  void*                     notify_; // inotify descriptor on Linux; unused on Windows
+
+  // Coalesced changes not yet delivered; touched only by the watcher thread
+  std::vector<Event>                                           pending_;
+  std::unordered_map<std::filesystem::path, size_t, PathHash>  pendingIndex_;
+  std::chrono::steady_clock::time_point                        firstPending_;
+
+}; // class DirectoryWatcher
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryWatcherCommon.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  Platform-independent parts of DirectoryWatcher
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <optional>
+#include "DirectoryWatcher.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+using Change = DirectoryWatcher::Change;
+
+// Net effect of two changes to the same path; none if they cancel out
+std::optional<Change> Merge( Change first, Change second )
+{
+  switch( first )
+  {
+  case Change::Added:
+    // Created and deleted within the window, e.g. an editor's temp file
+    if( second == Change::Removed )
+      return std::nullopt;
+    return Change::Added;
+  case Change::Removed:
+    // Deleted and recreated, e.g. a save by replacement
+    return ( second == Change::Removed ) ? Change::Removed : Change::Modified;
+  case Change::Modified:
+  default:
+    return ( second == Change::Removed ) ? Change::Removed : Change::Modified;
+  }
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Add a change to the pending batch. After an overflow the consumer rescans
+// everything, so earlier changes are dropped in favor of the overflow.
+
+void DirectoryWatcher::Record( const fs::path& path, Change change )
+{
+  if( pending_.empty() )
+    firstPending_ = std::chrono::steady_clock::now();
+
+  if( change == Change::Overflow )
+  {
+    pending_.clear();
+    pendingIndex_.clear();
+    pending_.push_back( { root_, Change::Overflow } );
+    return;
+  }
+
+  auto it = pendingIndex_.find( path );
+  if( it == pendingIndex_.end() )
+  {
+    pendingIndex_.emplace( path, pending_.size() );
+    pending_.push_back( { path, change } );
+    return;
+  }
+
+  auto& event = pending_[ it->second ];
+  auto merged = Merge( event.change, change );
+  if( merged )
+  {
+    event.change = *merged;
+    return;
+  }
+
+  // Cancelled events are left empty and skipped by Deliver
+  event.path.clear();
+  pendingIndex_.erase( it );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Hand the pending batch to the callback
+
+void DirectoryWatcher::Deliver()
+{
+  std::erase_if( pending_, []( const Event& event ) { return event.path.empty(); } );
+  if( !pending_.empty() && callback_ )
+    callback_( pending_ );
+  pending_.clear();
+  pendingIndex_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// How long the watcher thread may wait before the pending batch is due;
+// max() when nothing is pending
+
+std::chrono::milliseconds DirectoryWatcher::GetTimeout() const
+{
+  using namespace std::chrono;
+  if( pending_.empty() )
+    return milliseconds::max();
+  auto elapsed = duration_cast<milliseconds>( steady_clock::now() - firstPending_ );
+  return std::max( latency_ - elapsed, milliseconds( 0 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DirectoryWatcherPosix.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  *** POSIX implementation (inotify on Linux) ***
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WIN32)
+
+#include <cassert>
+#include <cerrno>
+#include <unordered_map>
+#include "DirectoryWatcher.h"
+#include "Log.h"
+
+// POSIX headers
+#include <unistd.h>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+constexpr int kInvalidFd = -1;
+
+int ToFd( void* handle )
+{
+  return static_cast<int>( reinterpret_cast<intptr_t>( handle ) );
+}
+
+void* FromFd( int fd )
+{
+  return reinterpret_cast<void*>( static_cast<intptr_t>( fd ) );
+}
+
+void CloseFd( void*& handle )
+{
+  if( ToFd( handle ) != kInvalidFd )
+    ::close( ToFd( handle ) );
+  handle = FromFd( kInvalidFd );
+}
+
+#if defined(__linux__)
+
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                IN_MODIFY | IN_ATTRIB | IN_ONLYDIR;
+
+// inotify reports names relative to the watched directory, so each watch
+// descriptor maps back to its directory
+using WatchMap = std::unordered_map<int, fs::path>;
+
+#endif
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+DirectoryWatcher::DirectoryWatcher() :
+  root_(),
+  dir_(),
+  isRecursive_( false ),
+  callback_(),
+  latency_(),
+  thread_(),
+  stop_( FromFd( kInvalidFd ) ),
+  notify_( FromFd( kInvalidFd ) ),
+  pending_(),
+  pendingIndex_(),
+  firstPending_()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+  Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Create the inotify instance, watch the root and start the watcher thread.
+// Subdirectories are watched individually, including ones created later.
+// inotify is Linux only; elsewhere Start fails.
+
+bool DirectoryWatcher::Start( const fs::path& dir, bool isRecursive, Callback callback,
+                              std::chrono::milliseconds latency )
+{
+  Stop();
+  root_ = dir;
+  root_.make_preferred();
+
+#if defined(__linux__)
+  auto notifyFd = ::inotify_init1( IN_CLOEXEC | IN_NONBLOCK );
+  auto stopFd = ::eventfd( 0, EFD_CLOEXEC );
+  notify_ = FromFd( notifyFd );
+  stop_ = FromFd( stopFd );
+  if( notifyFd == kInvalidFd || stopFd == kInvalidFd )
+  {
+    PKLOG_WARN( "inotify_init1 failed with error %d\n", errno );
+    Stop();
+    return false;
+  }
+
+  // Fail now rather than on the watcher thread if the root can't be watched
+  if( ::inotify_add_watch( notifyFd, root_.c_str(), kWatchMask ) < 0 )
+  {
+    PKLOG_WARN( "inotify_add_watch failed to watch %s with error %d\n", root_.c_str(), errno );
+    Stop();
+    return false;
+  }
+
+  isRecursive_ = isRecursive;
+  callback_ = std::move( callback );
+  latency_ = latency;
+  thread_ = std::thread( &DirectoryWatcher::WatchThread, this );
+  return true;
+#else
+  (void)isRecursive;
+  (void)callback;
+  (void)latency;
+  PKLOG_WARN( "DirectoryWatcher is not supported on this platform\n" );
+  return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Stop watching and wait for the watcher thread to exit
+
+void DirectoryWatcher::Stop()
+{
+  if( thread_.joinable() )
+  {
+    uint64_t signal = 1u;
+    [[maybe_unused]] auto result = ::write( ToFd( stop_ ), &signal, sizeof( signal ) );
+    assert( result == sizeof( signal ) );
+    thread_.join();
+  }
+  CloseFd( stop_ );
+  CloseFd( notify_ );
+  pending_.clear();
+  pendingIndex_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read inotify events and convert them until stopped
+
+void DirectoryWatcher::WatchThread()
+{
+#if defined(__linux__)
+  auto notifyFd = ToFd( notify_ );
+  WatchMap watches;
+
+  // Watch a directory and, if recursive, everything below it. Entries of a
+  // directory that appeared while watched may predate its watch, so they're
+  // reported as added.
+  std::function<void( const fs::path&, bool )> watch = [&]( const fs::path& dir, bool isNew )
+  {
+    auto wd = ::inotify_add_watch( notifyFd, dir.c_str(), kWatchMask );
+    if( wd < 0 )
+      return;
+    watches[ wd ] = dir;
+    if( !isRecursive_ && !isNew )
+      return;
+    File::EnumerateDirectory( dir, [&]( const File::DirEntry& entry )
+    {
+      if( isNew )
+        Record( entry.path, Change::Added );
+      if( isRecursive_ && entry.isDirectory && !entry.isLink )
+        watch( entry.path, isNew );
+      return true;
+    } );
+  };
+  watch( root_, false );
+
+  // Large enough for many events; each is at most sizeof( inotify_event ) + NAME_MAX + 1
+  alignas( inotify_event ) char buffer[ 64 * 1024 ];
+  for( ;; )
+  {
+    auto timeout = GetTimeout();
+    auto waitMs = ( timeout == std::chrono::milliseconds::max() ) ? 
+                  -1 : static_cast<int>( timeout.count() );
+    pollfd fds[] = { { notifyFd, POLLIN, 0 }, { ToFd( stop_ ), POLLIN, 0 } };
+    auto ready = ::poll( fds, 2, waitMs );
+    if( ready < 0 && errno == EINTR )
+      continue;
+    if( ready < 0 || ( fds[ 1 ].revents & POLLIN ) )
+      break;
+    if( ready == 0 )
+    {
+      Deliver();
+      continue;
+    }
+
+    auto length = ::read( notifyFd, buffer, sizeof( buffer ) );
+    if( length <= 0 )
+      continue;
+
+    for( char* p = buffer; p < buffer + length; )
+    {
+      auto pEvent = reinterpret_cast<const inotify_event*>( p );
+      p += sizeof( inotify_event ) + pEvent->len;
+
+      if( pEvent->mask & IN_Q_OVERFLOW )
+      {
+        Record( root_, Change::Overflow );
+        continue;
+      }
+      if( pEvent->mask & IN_IGNORED )
+      {
+        watches.erase( pEvent->wd );
+        continue;
+      }
+
+      auto it = watches.find( pEvent->wd );
+      if( it == watches.end() || pEvent->len == 0 )
+        continue;
+      auto path = it->second / pEvent->name;
+      if( pEvent->mask & ( IN_CREATE | IN_MOVED_TO ) )
+      {
+        Record( path, Change::Added );
+        if( isRecursive_ && ( pEvent->mask & IN_ISDIR ) )
+          watch( path, true );
+      }
+      else if( pEvent->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+      {
+        Record( path, Change::Removed );
+      }
+      else
+      {
+        Record( path, Change::Modified );
+      }
+    }
+
+    if( GetTimeout().count() == 0 )
+      Deliver();
+  }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // !_WIN32
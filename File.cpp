@@ -16,9 +16,14 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#if defined(_WIN32)
+
+#include <algorithm>
 #include <cassert>
 #include <limits>
+#include <new>
 #include "File.h"
+#include "FileStats.h"
 #include "Log.h"
 #include "StrUtil.h"
 
@@ -58,9 +63,104 @@ struct CreateFileParams
 
     if( flags & FileFlags::SequentialScan ) attribs |= FILE_FLAG_SEQUENTIAL_SCAN;
     if( flags & FileFlags::RandomAccess )   attribs |= FILE_FLAG_RANDOM_ACCESS;
+    if( flags & FileFlags::Async )          attribs |= FILE_FLAG_OVERLAPPED;
+    if( flags & FileFlags::Unbuffered )     attribs |= FILE_FLAG_NO_BUFFERING;
+    if( flags & FileFlags::WriteThrough )   attribs |= FILE_FLAG_WRITE_THROUGH;
+
+    // Append-only access; the system positions every write at the end
+    if( ( flags & FileFlags::Append ) && ( flags & FileFlags::Write ) )
+    {
+      access &= ~static_cast<uint32_t>( GENERIC_WRITE );
+      access |= FILE_APPEND_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE;
+      if( create == CREATE_ALWAYS )
+        create = OPEN_ALWAYS;
+    }
   }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// DeviceIoControl that waits for completion, even on overlapped handles
+
+bool ControlFile( HANDLE file, bool isAsync, DWORD code, void* pInput, DWORD inputSize )
+{
+  DWORD bytesReturned = 0u;
+  if( !isAsync )
+    return( ::DeviceIoControl( file, code, pInput, inputSize, NULL, 0, &bytesReturned, NULL ) == TRUE );
+
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = ::CreateEventW( NULL, TRUE, FALSE, NULL );
+  if( overlapped.hEvent == NULL )
+    return false;
+  overlapped.hEvent = reinterpret_cast<HANDLE>( reinterpret_cast<uintptr_t>( overlapped.hEvent ) | 1 );
+  auto success = ::DeviceIoControl( file, code, pInput, inputSize, NULL, 0, 
+                                    &bytesReturned, &overlapped );
+  if( !success && ::GetLastError() == ERROR_IO_PENDING )
+    success = ::GetOverlappedResult( file, &overlapped, &bytesReturned, TRUE );
+  ::CloseHandle( reinterpret_cast<HANDLE>( reinterpret_cast<uintptr_t>( overlapped.hEvent ) & ~uintptr_t( 1 ) ) );
+  return( success == TRUE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Permanently delete a file or empty directory with a single handle. POSIX
+// semantics remove the name immediately even if others have the file open.
+// Returns false for anything else, e.g. non-empty directories.
+
+bool DeleteNow( const fs::path& path )
+{
+  auto file = ::CreateFileW( path.c_str(), DELETE, 
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, 
+                             OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, 
+                             NULL );
+  if( file == INVALID_HANDLE_VALUE )
+    return false;
+
+  FILE_DISPOSITION_INFO_EX dispositionEx = { .Flags = FILE_DISPOSITION_FLAG_DELETE | 
+                                                      FILE_DISPOSITION_FLAG_POSIX_SEMANTICS |
+                                                      FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE };
+  auto success = ::SetFileInformationByHandle( file, FileDispositionInfoEx, 
+                                               &dispositionEx, sizeof(dispositionEx) );
+
+  // Older Windows and some file systems only support the classic form
+  if( !success && ::GetLastError() != ERROR_DIR_NOT_EMPTY )
+  {
+    FILE_DISPOSITION_INFO disposition = { TRUE }; // DeleteFile is also a macro
+    success = ::SetFileInformationByHandle( file, FileDispositionInfo, 
+                                            &disposition, sizeof(disposition) );
+  }
+  ::CloseHandle( file );
+  return( success == TRUE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Append a path in the form SHFileOperationW requires. Paths must be fully
+// qualified, hence fs::absolute. Directories must have any trailing slashes
+// removed. Each path ends in a null character; the list ends in two (!)
+
+void AppendShellPath( const fs::path& path, std::wstring& paths )
+{
+  std::wstring fullPath = fs::absolute( path ).wstring();
+  StrUtilT<wchar_t>::ToTrimmedTrailing( fullPath, L"\\/" );
+  paths += fullPath;
+  paths += L'\0';
+}
+
+bool ShellDelete( const std::wstring& paths, bool recycle )
+{
+  SHFILEOPSTRUCTW FileOp = { 0 };
+  FileOp.wFunc = FO_DELETE;
+  FileOp.fFlags = static_cast<FILEOP_FLAGS>( recycle ? FOF_ALLOWUNDO : 0x0 );
+  FileOp.fFlags |= FOF_NOCONFIRMATION | FOF_NOERRORUI | FOF_SILENT;
+
+  // c_str() supplies the final null
+  FileOp.pFrom = paths.c_str();
+
+  auto result = ::SHFileOperationW( &FileOp );
+  return( result == 0 && !FileOp.fAnyOperationsAborted );
+}
+
 File::Time FiletimeToStdTime( const FILETIME& ft )
 {
   // complex code likely reduces to single instruction
@@ -72,6 +172,80 @@ File::Time FiletimeToStdTime( const FILETIME& ft )
   return result;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// ReadFileScatter and WriteFileGather move whole system pages to and from a
+// contiguous range of an unbuffered, overlapped file. Returns the page list,
+// null terminated, or an empty list if the buffers don't qualify.
+
+template <class Vec>
+std::vector<FILE_SEGMENT_ELEMENT> GetSegments( std::span<const Vec> buffers, 
+                                               DWORD& totalBytes )
+{
+  SYSTEM_INFO systemInfo = { 0 };
+  ::GetSystemInfo( &systemInfo );
+  uint64_t pageSize = systemInfo.dwPageSize;
+
+  std::vector<FILE_SEGMENT_ELEMENT> segments;
+  uint64_t next = buffers.front().offset;
+  if( next % pageSize != 0 )
+    return segments;
+  for( const auto& buffer : buffers )
+  {
+    if( buffer.offset != next || buffer.bytes % pageSize != 0 ||
+        reinterpret_cast<uintptr_t>( buffer.data ) % pageSize != 0 )
+      return {};
+    next += buffer.bytes;
+  }
+  auto total = next - buffers.front().offset;
+  if( total > MAXDWORD )
+    return segments;
+
+  segments.reserve( static_cast<size_t>( total / pageSize ) + 1 );
+  for( const auto& buffer : buffers )
+  {
+    auto pPage = static_cast<const std::byte*>( buffer.data );
+    for( uint64_t i = 0; i < buffer.bytes; i += pageSize )
+    {
+      FILE_SEGMENT_ELEMENT segment = { 0 };
+      segment.Buffer = PtrToPtr64( pPage + i );
+      segments.push_back( segment );
+    }
+  }
+  segments.push_back( FILE_SEGMENT_ELEMENT{ 0 } );
+  totalBytes = static_cast<DWORD>( total );
+  return segments;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Overlapped transfer of many buffers, keeping several in flight. issue( i,
+// request ) starts buffer i. Requests are recycled in issue order, so a slot
+// is reused only after its earlier transfer has been waited on.
+
+template <class Issue>
+bool TransferBatch( size_t count, Issue issue )
+{
+  constexpr size_t kBatchDepth = 16;
+  auto depth = std::min( count, kBatchDepth );
+  auto requests = std::make_unique<File::AsyncRequest[]>( depth );
+
+  auto success = true;
+  for( size_t i = 0; i < count && success; ++i )
+  {
+    auto& request = requests[ i % depth ];
+    if( i >= depth )
+      success = request.Wait();
+    if( success )
+      success = issue( i, request );
+  }
+
+  // Waiting again on a completed request returns the same result
+  for( size_t i = 0; i < depth; ++i )
+    success = requests[ i ].Wait() && success;
+  return success;
+}
+
 } // end anonymous namespace
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -80,17 +254,46 @@ File::Time FiletimeToStdTime( const FILETIME& ft )
 
 File::File() :
   path_(),
-  file_( INVALID_HANDLE_VALUE )
+  file_( INVALID_HANDLE_VALUE ),
+  flags_(),
+  stats_( nullptr )
 {
 }
 
 File::File( const fs::path& path ) :
   path_( path ),
-  file_( INVALID_HANDLE_VALUE )
+  file_( INVALID_HANDLE_VALUE ),
+  flags_(),
+  stats_( nullptr )
 {
   path_.make_preferred(); // ensure Windows separators
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Move; the source is left closed
+
+File::File( File&& rhs ) noexcept :
+  path_( std::move( rhs.path_ ) ),
+  file_( std::exchange( rhs.file_, INVALID_HANDLE_VALUE ) ),
+  flags_( std::exchange( rhs.flags_, FileFlags() ) ),
+  stats_( std::exchange( rhs.stats_, nullptr ) )
+{
+}
+
+File& File::operator=( File&& rhs ) noexcept
+{
+  if( this != &rhs )
+  {
+    Close();
+    path_ = std::move( rhs.path_ );
+    file_ = std::exchange( rhs.file_, INVALID_HANDLE_VALUE );
+    flags_ = std::exchange( rhs.flags_, FileFlags() );
+    stats_ = std::exchange( rhs.stats_, nullptr );
+  }
+  return *this;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Dtor
@@ -122,10 +325,14 @@ bool File::Create( FileFlags flags )
     }
   }
 
+  FileStats::Timer timer( stats_, FileOp::Create );
   file_ = ::CreateFileW( path_.c_str(), cfp.access, cfp.share, NULL, cfp.create, cfp.attribs, NULL );
   if( file_ == INVALID_HANDLE_VALUE )
     PKLOG_WARN( "CreateFileW failed to create file %S with error %d\n", 
                 path_.c_str(), ::GetLastError() );
+  else
+    flags_ = flags;
+  timer.Done( path_, 0, IsOpen() );
   return IsOpen();
 }
 
@@ -143,10 +350,14 @@ bool File::Open( FileFlags flags )
     cfp.attribs |= FILE_FLAG_BACKUP_SEMANTICS;
 
   Close();
+  FileStats::Timer timer( stats_, FileOp::Open );
   file_ = ::CreateFileW( path_.c_str(), cfp.access, cfp.share, NULL, cfp.create, cfp.attribs, NULL );
   if( file_ == INVALID_HANDLE_VALUE )
     PKLOG_WARN( "CreateFileW failed to open file %S with error %d\n", 
                 path_.c_str(), ::GetLastError() );
+  else
+    flags_ = flags;
+  timer.Done( path_, 0, IsOpen() );
   return IsOpen();
 }
 
@@ -156,6 +367,7 @@ void File::Close()
   {
     ::CloseHandle( file_ );
     file_ = INVALID_HANDLE_VALUE;
+    flags_ = FileFlags();
   }    
 }
 
@@ -218,6 +430,115 @@ bool File::GetFileTimes( File::Times& fileTimes ) const
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Length, times, attributes and IDs in one call. A closed file is opened
+// briefly for attribute access only, so IDs are reported either way; if even
+// that is refused it's queried by path, without IDs. Returns false if the file
+// doesn't exist.
+
+bool File::GetInfo( File::Info& info ) const
+{
+  auto hFile = file_;
+  if( !IsOpen() )
+  {
+    // Backup semantics allows directories to be opened
+    hFile = ::CreateFileW( path_.c_str(), FILE_READ_ATTRIBUTES, 
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, 
+                           OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL );
+    if( hFile == INVALID_HANDLE_VALUE )
+    {
+      WIN32_FILE_ATTRIBUTE_DATA fa = { 0 };
+      if( !::GetFileAttributesExW( path_.c_str(), GetFileExInfoStandard, &fa ) )
+        return false;
+      ULARGE_INTEGER length = { { fa.nFileSizeLow, fa.nFileSizeHigh } };
+      info.length = length.QuadPart;
+      info.times.creationTime   = FiletimeToStdTime( fa.ftCreationTime );
+      info.times.lastAccessTime = FiletimeToStdTime( fa.ftLastAccessTime );
+      info.times.lastWriteTime  = FiletimeToStdTime( fa.ftLastWriteTime );
+      info.attributes = fa.dwFileAttributes;
+      info.volumeId = 0u;
+      info.fileId = 0u;
+      info.isDirectory = ( fa.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+      return true;
+    }
+  }
+
+  BY_HANDLE_FILE_INFORMATION fi = { 0 };
+  auto success = ( ::GetFileInformationByHandle( hFile, &fi ) == TRUE );
+  auto error = ::GetLastError();
+  if( hFile != file_ )
+    ::CloseHandle( hFile );
+  if( !success )
+  {
+    PKLOG_WARN( "GetFileInformationByHandle failed for %S with error %d\n", 
+                path_.c_str(), error );
+    return false;
+  }
+  ULARGE_INTEGER length = { { fi.nFileSizeLow, fi.nFileSizeHigh } };
+  ULARGE_INTEGER fileId = { { fi.nFileIndexLow, fi.nFileIndexHigh } };
+  info.length = length.QuadPart;
+  info.times.creationTime   = FiletimeToStdTime( fi.ftCreationTime );
+  info.times.lastAccessTime = FiletimeToStdTime( fi.ftLastAccessTime );
+  info.times.lastWriteTime  = FiletimeToStdTime( fi.ftLastWriteTime );
+  info.attributes = fi.dwFileAttributes;
+  info.volumeId = fi.dwVolumeSerialNumber;
+  info.fileId = fileId.QuadPart;
+  info.isDirectory = ( fi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Invoke the callback with the length, times and attributes of every entry in
+// the directory, excluding "." and "..". Not recursive. The whole listing is
+// fetched in large batches from the directory itself, so no per-entry calls
+// are made. Returns false if the directory can't be read.
+
+bool File::EnumerateDirectory( const fs::path& dir, const DirCallback& callback )
+{
+  WIN32_FIND_DATAW fd = { 0 };
+  auto pattern = dir / L"*";
+  auto hFind = ::FindFirstFileExW( pattern.c_str(), FindExInfoBasic, &fd, 
+                                   FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH );
+  if( hFind == INVALID_HANDLE_VALUE )
+  {
+    // Empty root directories have no "." entry
+    auto error = ::GetLastError();
+    if( error == ERROR_FILE_NOT_FOUND )
+      return true;
+    PKLOG_WARN( "FindFirstFileExW failed to enumerate %S with error %d\n", 
+                dir.c_str(), error );
+    return false;
+  }
+
+  DirEntry entry;
+  entry.path = dir;
+  entry.path /= L"*";
+  auto isDone = false;
+  do
+  {
+    std::wstring_view name( fd.cFileName );
+    if( name == L"." || name == L".." )
+      continue;
+
+    entry.path.replace_filename( name );
+    uint64_t lo = fd.nFileSizeLow;
+    uint64_t hi = fd.nFileSizeHigh;
+    entry.length = lo + ( hi << 32 );
+    entry.times.creationTime   = FiletimeToStdTime( fd.ftCreationTime );
+    entry.times.lastAccessTime = FiletimeToStdTime( fd.ftLastAccessTime );
+    entry.times.lastWriteTime  = FiletimeToStdTime( fd.ftLastWriteTime );
+    entry.attributes = fd.dwFileAttributes;
+    entry.isDirectory = ( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+    entry.isLink = ( fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) != 0;
+    isDone = !callback( entry );
+  } while( !isDone && ::FindNextFileW( hFind, &fd ) );
+
+  ::FindClose( hFind );
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Set the next position for reading or writing. Position is always from the
@@ -226,6 +547,7 @@ bool File::GetFileTimes( File::Times& fileTimes ) const
 bool File::SetPos( uint64_t pos ) const
 {
   assert( IsOpen() );
+  assert( !( flags_ & FileFlags::Async ) ); // overlapped handles have no position
 
   // With FILE_BEGIN, largePos is interpreted as unsigned, so cast is safe
   LARGE_INTEGER largePos = { .QuadPart = static_cast<LONGLONG>(pos) };
@@ -233,17 +555,6 @@ bool File::SetPos( uint64_t pos ) const
   return success == TRUE;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-//
-// Read a buffer from the current file position
-
-bool File::Read( void* pBuffer, uint32_t bytes ) const
-{
-  uint32_t bytesRead = 0;
-  auto success = Read( pBuffer, bytes, bytesRead );
-  return ( success && ( bytes == bytesRead ) );
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Read a buffer from the current file position; returns bytesRead
@@ -254,43 +565,370 @@ bool File::Read( void* pBuffer, uint32_t bytes, uint32_t& bytesRead ) const
   assert( IsOpen() );
   assert( pBuffer != nullptr );
   assert( bytes > 0 );
+  assert( !( flags_ & FileFlags::Async ) ); // use ReadAsync
 
   // If this fails, adjust the function to be a loop
   assert( bytes <= std::numeric_limits<DWORD>::max() );
   DWORD bytes32 = static_cast<DWORD>( bytes );
 
+  FileStats::Timer timer( stats_, FileOp::Read );
   DWORD br = 0u;
   auto success = ::ReadFile( file_, pBuffer, bytes32, &br, NULL );
   bytesRead = br;
+  timer.Done( path_, br, success == TRUE );
+  return( success == TRUE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write a buffer to the current file position. Buffers larger than the I/O
+// chunk size are written with multiple calls.
+
+bool File::Write( const void* pBuffer, uint64_t bytes )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr || bytes == 0 );
+  assert( !( flags_ & FileFlags::Async ) ); // use WriteAsync
+
+  FileStats::Timer timer( stats_, FileOp::Write );
+  auto chunkSize = GetIoChunkSize();
+  auto pSrc = static_cast<const uint8_t*>( pBuffer );
+  uint64_t total = 0u;
+  while( bytes > 0 )
+  {
+    auto chunk = static_cast<DWORD>( std::min<uint64_t>( bytes, chunkSize ) );
+    DWORD bytesWritten = 0;
+    auto success = ::WriteFile( file_, pSrc, chunk, &bytesWritten, NULL );
+    total += bytesWritten;
+    if( !success || ( chunk != bytesWritten ) )
+    {
+      timer.Done( path_, total, false );
+      return false;
+    }
+    pSrc += chunk;
+    bytes -= chunk;
+  }
+  timer.Done( path_, total, true );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Allocate storage for at least the given number of bytes without changing
+// the file length. Windows releases unused allocation when the file closes.
+
+bool File::Reserve( uint64_t bytes )
+{
+  assert( IsOpen() );
+  FILE_ALLOCATION_INFO allocInfo = { .AllocationSize = { .QuadPart = static_cast<LONGLONG>( bytes ) } };
+  auto success = ::SetFileInformationByHandle( file_, FileAllocationInfo, 
+                                               &allocInfo, sizeof(allocInfo) );
+  return( success == TRUE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Truncate or extend the file. Extended bytes read as zero.
+
+bool File::SetLength( uint64_t bytes )
+{
+  assert( IsOpen() );
+  FILE_END_OF_FILE_INFO eofInfo = { .EndOfFile = { .QuadPart = static_cast<LONGLONG>( bytes ) } };
+  auto success = ::SetFileInformationByHandle( file_, FileEndOfFileInfo, 
+                                               &eofInfo, sizeof(eofInfo) );
   return( success == TRUE );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Write a buffer to the current file position
+// Mark the file sparse, so ranges that are never written or that are punched
+// out take no disk space. Fails on file systems without sparse support.
+
+bool File::SetSparse( bool isSparse )
+{
+  assert( IsOpen() );
+  FILE_SET_SPARSE_BUFFER sparse = { .SetSparse = static_cast<BOOLEAN>( isSparse ) };
+  return ControlFile( file_, flags_ & FileFlags::Async, FSCTL_SET_SPARSE, 
+                      &sparse, sizeof(sparse) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Zero a range of the file. In sparse files the range is also deallocated.
+
+bool File::PunchHole( uint64_t offset, uint64_t length )
+{
+  assert( IsOpen() );
+  FILE_ZERO_DATA_INFORMATION zero = {};
+  zero.FileOffset.QuadPart = static_cast<LONGLONG>( offset );
+  zero.BeyondFinalZero.QuadPart = static_cast<LONGLONG>( offset + length );
+  return ControlFile( file_, flags_ & FileFlags::Async, FSCTL_SET_ZERO_DATA, 
+                      &zero, sizeof(zero) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read a buffer from the given file offset; returns bytesRead, which is zero
+// at or beyond the end of the file. Safe to call from multiple threads. On
+// non-Async files Windows still leaves the file position after the bytes read,
+// so don't mix with Read/SetPos on the same File from other threads.
 
-bool File::Write( const void* pBuffer, uint32_t bytes )
+bool File::ReadAt( uint64_t offset, void* pBuffer, uint32_t bytes, uint32_t& bytesRead ) const
 {
   assert( path_.has_filename() );
   assert( IsOpen() );
   assert( pBuffer != nullptr );
-  assert( bytes <= std::numeric_limits<DWORD>::max() );
-  DWORD bytes32 = static_cast<DWORD>( bytes );
-  DWORD bytesWritten = 0;
-  auto success = ::WriteFile( file_, pBuffer, bytes32, &bytesWritten, NULL );
+  assert( bytes > 0 );
+
+  if( flags_ & FileFlags::Async )
+  {
+    AsyncRequest request;
+    return( ReadAsync( offset, pBuffer, bytes, request ) && request.Wait( bytesRead ) );
+  }
+
+  OVERLAPPED overlapped = {};
+  ULARGE_INTEGER largeOffset = { .QuadPart = offset };
+  overlapped.Offset = largeOffset.LowPart;
+  overlapped.OffsetHigh = largeOffset.HighPart;
+
+  FileStats::Timer timer( stats_, FileOp::Read );
+  DWORD br = 0u;
+  auto success = ( ::ReadFile( file_, pBuffer, bytes, &br, &overlapped ) == TRUE ) || 
+                 ( ::GetLastError() == ERROR_HANDLE_EOF );
+  bytesRead = br;
+  timer.Done( path_, br, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write a buffer at the given file offset, extending the file if necessary
+
+bool File::WriteAt( uint64_t offset, const void* pBuffer, uint32_t bytes )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  if( flags_ & FileFlags::Async )
+  {
+    AsyncRequest request;
+    return( WriteAsync( offset, pBuffer, bytes, request ) && request.Wait() );
+  }
+
+  OVERLAPPED overlapped = {};
+  ULARGE_INTEGER largeOffset = { .QuadPart = offset };
+  overlapped.Offset = largeOffset.LowPart;
+  overlapped.OffsetHigh = largeOffset.HighPart;
+
+  FileStats::Timer timer( stats_, FileOp::Write );
+  DWORD bytesWritten = 0u;
+  auto success = ::WriteFile( file_, pBuffer, bytes, &bytesWritten, &overlapped );
+  timer.Done( path_, bytesWritten, success && ( bytes == bytesWritten ) );
   return( success && ( bytes == bytesWritten ) );
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read many buffers. Unbuffered overlapped files reading whole pages into a
+// contiguous range use a single ReadFileScatter; other overlapped files issue
+// the reads as a batch; otherwise each buffer is read in turn.
+
+bool File::ReadV( std::span<const IoVec> buffers ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  if( buffers.empty() )
+    return true;
+
+  if( ( flags_ & FileFlags::Unbuffered ) && ( flags_ & FileFlags::Async ) )
+  {
+    DWORD totalBytes = 0u;
+    auto segments = GetSegments( buffers, totalBytes );
+    if( !segments.empty() )
+    {
+      AsyncRequest request;
+      request.Begin( *this, buffers.front().offset, totalBytes, false );
+      auto pOverlapped = reinterpret_cast<OVERLAPPED*>( request.native_ );
+      if( !::ReadFileScatter( file_, segments.data(), totalBytes, NULL, pOverlapped ) &&
+          ::GetLastError() != ERROR_IO_PENDING )
+      {
+        request.Complete( false, 0 );
+        return false;
+      }
+      return request.Wait();
+    }
+  }
+
+  if( flags_ & FileFlags::Async )
+  {
+    return TransferBatch( buffers.size(), [&]( size_t i, AsyncRequest& request )
+    {
+      const auto& buffer = buffers[ i ];
+      return ReadAsync( buffer.offset, buffer.data, buffer.bytes, request );
+    } );
+  }
+
+  for( const auto& buffer : buffers )
+  {
+    uint32_t bytesRead = 0u;
+    if( !ReadAt( buffer.offset, buffer.data, buffer.bytes, bytesRead ) || 
+        bytesRead != buffer.bytes )
+      return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write many buffers; the mirror of ReadV, using WriteFileGather
+
+bool File::WriteV( std::span<const ConstIoVec> buffers )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  if( buffers.empty() )
+    return true;
+
+  if( ( flags_ & FileFlags::Unbuffered ) && ( flags_ & FileFlags::Async ) )
+  {
+    DWORD totalBytes = 0u;
+    auto segments = GetSegments( buffers, totalBytes );
+    if( !segments.empty() )
+    {
+      AsyncRequest request;
+      request.Begin( *this, buffers.front().offset, totalBytes, true );
+      auto pOverlapped = reinterpret_cast<OVERLAPPED*>( request.native_ );
+      if( !::WriteFileGather( file_, segments.data(), totalBytes, NULL, pOverlapped ) &&
+          ::GetLastError() != ERROR_IO_PENDING )
+      {
+        request.Complete( false, 0 );
+        return false;
+      }
+      return request.Wait();
+    }
+  }
+
+  if( flags_ & FileFlags::Async )
+  {
+    return TransferBatch( buffers.size(), [&]( size_t i, AsyncRequest& request )
+    {
+      const auto& buffer = buffers[ i ];
+      return WriteAsync( buffer.offset, buffer.data, buffer.bytes, request );
+    } );
+  }
+
+  for( const auto& buffer : buffers )
+  {
+    if( !WriteAt( buffer.offset, buffer.data, buffer.bytes ) )
+      return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Windows has no read-ahead call for file handles, so map the range and
+// prefetch the view. The pages stay in the system cache after the view is
+// unmapped.
+
+bool File::Prefetch( uint64_t offset, uint64_t length ) const
+{
+  assert( IsOpen() );
+  if( offset >= GetLength() )
+    return true;
+  MapView view;
+  return view.Map( *this, offset, length ) && view.Prefetch();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue an overlapped read at the given file offset. Reads at or beyond the end
+// of the file complete successfully with zero bytes.
+
+bool File::ReadAsync( uint64_t offset, void* pBuffer, uint32_t bytes, 
+                      AsyncRequest& request ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( flags_ & FileFlags::Async );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+  assert( !request.IsPending() );
+
+  request.Begin( *this, offset, bytes, false );
+  auto pOverlapped = reinterpret_cast<OVERLAPPED*>( request.native_ );
+  if( ::ReadFile( file_, pBuffer, bytes, NULL, pOverlapped ) )
+    return true;
+
+  auto error = ::GetLastError();
+  if( error == ERROR_IO_PENDING )
+    return true;
+
+  request.Complete( error == ERROR_HANDLE_EOF, 0 );
+  return( error == ERROR_HANDLE_EOF );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue an overlapped write at the given file offset
+
+bool File::WriteAsync( uint64_t offset, const void* pBuffer, uint32_t bytes, 
+                       AsyncRequest& request )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( flags_ & FileFlags::Async );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+  assert( !request.IsPending() );
+
+  request.Begin( *this, offset, bytes, true );
+  auto pOverlapped = reinterpret_cast<OVERLAPPED*>( request.native_ );
+  if( ::WriteFile( file_, pBuffer, bytes, NULL, pOverlapped ) ||
+      ::GetLastError() == ERROR_IO_PENDING )
+    return true;
+
+  request.Complete( false, 0 );
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Physical sector size of the volume holding the file; the alignment required
+// for unbuffered I/O
+
+uint32_t File::GetSectorSize() const
+{
+  assert( IsOpen() );
+  constexpr uint32_t kDefaultSectorSize = 4096;
+  FILE_STORAGE_INFO storageInfo = { 0 };
+  if( !::GetFileInformationByHandleEx( file_, FileStorageInfo, 
+                                       &storageInfo, sizeof(storageInfo) ) )
+    return kDefaultSectorSize;
+
+  uint32_t sectorSize = storageInfo.PhysicalBytesPerSectorForPerformance;
+  if( sectorSize == 0 || ( sectorSize & ( sectorSize - 1 ) ) != 0 )
+    return kDefaultSectorSize;
+  return sectorSize;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Flush file to storage medium. Does nothing for directories or read-only files
 
-void File::Flush() const
+bool File::Flush() const
 {
   assert( path_.has_filename() );
   assert( IsOpen() );
-  [[maybe_unused]] BOOL success = ::FlushFileBuffers( file_ );
-  assert( success );
+  FileStats::Timer timer( stats_, FileOp::Flush );
+  auto success = ( ::FlushFileBuffers( file_ ) == TRUE );
+  timer.Done( path_, 0, success );
+  if( !success )
+    PKLOG_WARN( "FlushFileBuffers failed for %S with error %d\n", path_.c_str(), ::GetLastError() );
+  return success;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -304,21 +942,229 @@ bool File::Delete( bool recycle ) const
   if( IsOpen() )
     return false;
 
-  SHFILEOPSTRUCTW FileOp = { 0 };
-  FileOp.wFunc = FO_DELETE;
-  FileOp.fFlags = static_cast<FILEOP_FLAGS>( recycle ? FOF_ALLOWUNDO : 0x0 );
-  FileOp.fFlags |= FOF_NOCONFIRMATION | FOF_NOERRORUI | FOF_SILENT;
+  // Permanent deletes of files and empty directories skip the shell
+  FileStats::Timer timer( stats_, FileOp::Delete );
+  if( !recycle && DeleteNow( path_ ) )
+  {
+    timer.Done( path_, 0, true );
+    return true;
+  }
 
-  // Path must be fully qualfied, hence fs::absolute.
-  // Directories must have any trailing slashes removed.
-  // String is required to end in two null characters (!)
-  std::wstring fullPath = fs::absolute(path_).wstring();
-  StrUtilT<wchar_t>::ToTrimmedTrailing( fullPath, L"\\/" );
-  fullPath += L'\0';
-  FileOp.pFrom = fullPath.c_str();
-    
-  auto result = ::SHFileOperationW( &FileOp );
-  return( result == 0 );
+  std::wstring paths;
+  AppendShellPath( path_, paths );
+  auto success = ShellDelete( paths, recycle );
+  timer.Done( path_, 0, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Delete many files or directories. Recycled paths go to the shell in a
+// single operation. Permanent deletes are made directly, with only non-empty
+// directories left for one shell operation. Returns true if everything was
+// deleted.
+
+bool File::DeleteFiles( std::span<const fs::path> paths, bool recycle )
+{
+  std::wstring shellPaths;
+  for( const auto& path : paths )
+  {
+    if( !recycle && DeleteNow( path ) )
+      continue;
+    AppendShellPath( path, shellPaths );
+  }
+  return( shellPaths.empty() || ShellDelete( shellPaths, recycle ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Map [offset, offset + length) of the file into memory. Length is clamped to
+// the end of the file. Fails for empty ranges, since Windows can't map zero
+// bytes. Unmaps any existing view.
+
+bool File::MapView::Map( const File& file, uint64_t offset, uint64_t length )
+{
+  assert( file.IsOpen() );
+  Unmap();
+
+  auto fileLen = file.GetLength();
+  if( offset >= fileLen )
+    return false;
+  length = std::min( length, fileLen - offset );
+
+  // View must begin on an allocation granularity boundary
+  SYSTEM_INFO si = { 0 };
+  ::GetSystemInfo( &si );
+  uint64_t granularity = si.dwAllocationGranularity;
+  uint64_t viewStart = offset - ( offset % granularity );
+  uint64_t viewLen = length + ( offset - viewStart );
+  if( viewLen > std::numeric_limits<SIZE_T>::max() )
+    return false;
+
+  auto mapping = ::CreateFileMappingW( file.file_, NULL, PAGE_READONLY, 0, 0, NULL );
+  if( mapping == NULL )
+  {
+    PKLOG_WARN( "CreateFileMappingW failed to map file %S with error %d\n",
+                file.path_.c_str(), ::GetLastError() );
+    return false;
+  }
+
+  // The view keeps the mapping alive, so the mapping handle isn't retained
+  ULARGE_INTEGER start = { .QuadPart = viewStart };
+  view_ = ::MapViewOfFile( mapping, FILE_MAP_READ, start.HighPart, start.LowPart,
+                           static_cast<SIZE_T>( viewLen ) );
+  ::CloseHandle( mapping );
+  if( view_ == nullptr )
+  {
+    PKLOG_WARN( "MapViewOfFile failed to map file %S with error %d\n",
+                file.path_.c_str(), ::GetLastError() );
+    return false;
+  }
+
+  auto first = static_cast<const std::byte*>( view_ ) + ( offset - viewStart );
+  data_ = { first, static_cast<size_t>( length ) };
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PrefetchVirtualMemory issues large reads for the range instead of faulting
+// pages in one at a time
+
+bool File::MapView::Prefetch( size_t offset, size_t length ) const
+{
+  assert( IsMapped() );
+  if( offset >= data_.size() )
+    return true;
+  length = std::min( length, data_.size() - offset );
+
+  WIN32_MEMORY_RANGE_ENTRY range = { const_cast<std::byte*>( data_.data() + offset ), length };
+  if( ::PrefetchVirtualMemory( ::GetCurrentProcess(), 1, &range, 0 ) == TRUE )
+    return true;
+  PKLOG_WARN( "PrefetchVirtualMemory failed with error %d\n", ::GetLastError() );
+  return false;
+}
+
+void File::MapView::Unmap()
+{
+  if( view_ != nullptr )
+  {
+    [[maybe_unused]] auto success = ::UnmapViewOfFile( view_ );
+    assert( success );
+    view_ = nullptr;
+    data_ = {};
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AsyncRequest
+
+File::AsyncRequest::AsyncRequest() :
+  native_(),
+  event_( ::CreateEventW( NULL, TRUE, FALSE, NULL ) ),
+  file_( INVALID_HANDLE_VALUE ),
+  stats_( nullptr ),
+  path_(),
+  start_(),
+  bytesRequested_( 0u ),
+  bytesTransferred_( 0u ),
+  isPending_( false ),
+  success_( false ),
+  isWrite_( false ),
+  isTimed_( false )
+{
+  assert( event_ != NULL );
+}
+
+File::AsyncRequest::~AsyncRequest()
+{
+  if( isPending_ )
+  {
+    Cancel();
+    Wait();
+  }
+  if( event_ != NULL )
+    ::CloseHandle( event_ );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Prepare the OVERLAPPED structure for a new operation
+
+void File::AsyncRequest::Begin( const File& file, uint64_t offset, uint32_t bytes, bool isWrite )
+{
+  static_assert( sizeof( OVERLAPPED ) == kNativeSize );
+  static_assert( alignof( OVERLAPPED ) <= alignof( std::max_align_t ) );
+
+  auto pOverlapped = new( native_ ) OVERLAPPED{};
+  ULARGE_INTEGER largeOffset = { .QuadPart = offset };
+  pOverlapped->Offset = largeOffset.LowPart;
+  pOverlapped->OffsetHigh = largeOffset.HighPart;
+
+  // Setting the low-order bit of the event keeps the completion from being
+  // queued to any I/O completion port bound to the handle; the request is
+  // always completed by waiting on it directly
+  pOverlapped->hEvent = reinterpret_cast<HANDLE>( reinterpret_cast<uintptr_t>( event_ ) | 1 );
+
+  file_ = file.file_;
+  stats_ = file.stats_;
+  isWrite_ = isWrite;
+  isTimed_ = ( file.stats_ != nullptr ) || FileStats::IsEnabled();
+  if( isTimed_ )
+  {
+    path_ = file.path_;
+    start_ = std::chrono::steady_clock::now();
+  }
+  bytesRequested_ = bytes;
+  bytesTransferred_ = 0u;
+  isPending_ = true;
+  success_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Poll for completion without blocking. Once complete, Wait() returns
+// immediately.
+
+bool File::AsyncRequest::IsComplete() const
+{
+  if( !isPending_ )
+    return true;
+  auto pOverlapped = reinterpret_cast<const OVERLAPPED*>( native_ );
+  return HasOverlappedIoCompleted( pOverlapped );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Block until the operation completes; returns bytesTransferred, which may be
+// short for reads that reach the end of the file
+
+bool File::AsyncRequest::Wait( uint32_t& bytesTransferred )
+{
+  if( isPending_ )
+  {
+    auto pOverlapped = reinterpret_cast<OVERLAPPED*>( native_ );
+    DWORD bytes = 0u;
+    auto success = ::GetOverlappedResult( file_, pOverlapped, &bytes, TRUE );
+    Complete( success || ::GetLastError() == ERROR_HANDLE_EOF, bytes );
+  }
+  bytesTransferred = bytesTransferred_;
+  return success_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Request cancellation of a pending operation. Wait() must still be called;
+// a cancelled operation may have completed anyway.
+
+void File::AsyncRequest::Cancel()
+{
+  if( isPending_ )
+  {
+    auto pOverlapped = reinterpret_cast<OVERLAPPED*>( native_ );
+    ::CancelIoEx( file_, pOverlapped );
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -326,9 +1172,33 @@ bool File::Delete( bool recycle ) const
 // Rename the file or directory
 // Prefer fs::rename
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Atomically replace target with source; source no longer exists afterwards.
+// Target need not exist. When it does, ReplaceFileW keeps its attributes and
+// security descriptor. Both files must be closed and on the same volume.
+
+bool File::Replace( const fs::path& source, const fs::path& target )
+{
+  if( ::ReplaceFileW( target.c_str(), source.c_str(), NULL, 
+                      REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL ) )
+    return true;
+
+  // ReplaceFileW requires an existing target
+  if( ::MoveFileExW( source.c_str(), target.c_str(), 
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+    return true;
+
+  PKLOG_WARN( "MoveFileExW failed to replace file %S with error %d\n", 
+              target.c_str(), ::GetLastError() );
+  return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Determine if file or directory exists
 // Prefer fs::exists
 
 ///////////////////////////////////////////////////////////////////////////////
+
+#endif // _WIN32
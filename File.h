@@ -20,7 +20,19 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace PKIsensee
 {
@@ -38,6 +50,11 @@ enum class FileFlags : uint32_t
   SharedDelete   = 1 << 4,
   SequentialScan = 1 << 5,
   RandomAccess   = 1 << 6,
+  Async          = 1 << 7, // overlapped I/O; use ReadAsync/WriteAsync
+  Unbuffered     = 1 << 8, // bypass the system cache; see AlignedBuffer
+  WriteThrough   = 1 << 9, // writes go straight to storage
+  Append         = 1 << 10, // with Write: every write lands at the end of file,
+                            // and Create keeps existing contents
 };
 
 constexpr FileFlags operator | ( FileFlags lhs, FileFlags rhs )
@@ -52,6 +69,8 @@ constexpr bool operator & ( FileFlags lhs, FileFlags rhs )
   return static_cast<bool>( static_cast<T>( lhs ) & static_cast<T>( rhs ) );
 }
 
+class FileStats;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class File
@@ -66,17 +85,80 @@ public:
     Time lastWriteTime;
   };
 
+  // One entry of a directory listing
+  struct DirEntry
+  {
+    std::filesystem::path path;        // directory / name
+    uint64_t              length;
+    Times                 times;
+    uint32_t              attributes;  // native attribute bits
+    bool                  isDirectory;
+    bool                  isLink;      // symbolic link, junction or other reparse point
+  };
+
+  // Metadata snapshot from a single system call. The IDs identify the file
+  // across renames and hard links; both are zero when unavailable.
+  struct Info
+  {
+    uint64_t length;
+    Times    times;
+    uint32_t attributes;  // native attribute bits
+    uint64_t volumeId;    // volume serial number on Windows; st_dev on POSIX
+    uint64_t fileId;      // file index on Windows; inode on POSIX
+    bool     isDirectory;
+  };
+
+  // One buffer of a vectored read or write, at its own file offset
+  struct IoVec
+  {
+    uint64_t offset;
+    void*    data;
+    uint32_t bytes;
+  };
+
+  struct ConstIoVec
+  {
+    uint64_t    offset;
+    const void* data;
+    uint32_t    bytes;
+  };
+
+  // Tuning for Copy. Progress is invoked after each chunk is written; return
+  // false to cancel. Files of at least unbufferedThreshold bytes bypass the
+  // system cache on both ends so a large copy doesn't evict everything else.
+  struct CopyOptions
+  {
+    uint32_t chunkSize = 4 * 1024 * 1024;
+    uint32_t depth = 4; // chunks in flight; at least 2
+    uint64_t unbufferedThreshold = 64 * 1024 * 1024;
+    std::function<bool( uint64_t bytesCopied, uint64_t totalBytes )> progress;
+  };
+
+  // Content hashes from HashFile or FileHasher; see FileHash.h
+  struct Digest
+  {
+    uint64_t                  xxh64;
+    std::array<std::byte, 32> sha256; // zero unless requested
+  };
+
+  // Return false to stop enumerating
+  using DirCallback = std::function<bool( const DirEntry& )>;
+
 public:
 
   File();
   explicit File( const std::filesystem::path& );
   ~File();
 
-  // Disable copy/move
+  // Disable copy; moving transfers the open handle
   File( const File& ) = delete;
   File& operator=( const File& ) = delete;
-  File( File&& ) = delete;
-  File& operator=( File&& ) = delete;
+  File( File&& ) noexcept;
+  File& operator=( File&& ) noexcept;
+
+  class AsyncRequest;
+  class AlignedBuffer;
+  class ChunkRange;
 
   bool Create( FileFlags fileFlags );
   bool Open( FileFlags fileFlags );
@@ -85,13 +167,70 @@ public:
   
   uint64_t GetLength() const;
   bool GetFileTimes( File::Times& ) const;
-  bool Read( void*, uint32_t ) const;
+  bool GetInfo( File::Info& ) const;
+  static bool EnumerateDirectory( const std::filesystem::path& dir, const DirCallback& );
+  bool Read( void*, uint64_t ) const;
   bool Read( void*, uint32_t, uint32_t& ) const;
   bool SetPos( uint64_t ) const;
-  bool Write( const void*, uint32_t );
-  void Flush() const;
+  bool Write( const void*, uint64_t );
+  bool Flush() const;
+
+  // Allocation and sparse regions. Reserve allocates disk space up front so a
+  // file written incrementally stays contiguous; the length is unchanged.
+  // SetLength moves the end of file without touching the file position.
+  bool Reserve( uint64_t bytes );
+  bool SetLength( uint64_t bytes );
+  bool SetSparse( bool isSparse = true );
+  bool PunchHole( uint64_t offset, uint64_t length );
+
+  // Positional I/O. Each call carries its own offset, so concurrent calls on
+  // one File don't race on a shared position.
+  bool ReadAt( uint64_t offset, void*, uint32_t ) const;
+  bool ReadAt( uint64_t offset, void*, uint32_t, uint32_t& ) const;
+  bool WriteAt( uint64_t offset, const void*, uint32_t );
+
+  // Vectored I/O. One call fills or drains many buffers; succeeds only if
+  // every buffer is transferred in full, so reading past the end fails.
+  bool ReadV( std::span<const IoVec> ) const;
+  bool WriteV( std::span<const ConstIoVec> );
+
+  // Read-ahead hints. Prefetch starts reading a range into the system cache
+  // and returns once the reads are issued, so later reads of the range hit
+  // memory. PrefetchFiles warms whole files across threads; zero threads
+  // uses one per hardware thread.
+  bool Prefetch( uint64_t offset = 0, 
+                 uint64_t length = std::numeric_limits<uint64_t>::max() ) const;
+  static bool PrefetchFiles( std::span<const std::filesystem::path>, uint32_t threadCount = 0 );
+
+  // Overlapped I/O on files opened with FileFlags::Async. Returns false if the
+  // request could not be issued; otherwise wait on the request for the result.
+  bool ReadAsync( uint64_t offset, void*, uint32_t, AsyncRequest& ) const;
+  bool WriteAsync( uint64_t offset, const void*, uint32_t, AsyncRequest& );
+
+  // Unbuffered files require buffer addresses, transfer sizes and offsets to be
+  // multiples of the sector size. AllocateAligned buffers always qualify.
+  uint32_t GetSectorSize() const;
+  AlignedBuffer AllocateAligned( size_t bytes ) const;
+
+  // Maximum bytes issued per native read/write call when transferring large
+  // buffers. Rounded to a multiple of 64K so chunks stay sector aligned.
+  static void SetIoChunkSize( uint32_t );
+  static uint32_t GetIoChunkSize();
   
+  // Hash the file in one streaming pass: chunks are read ahead while the
+  // previous chunk is hashed, so memory use stays at a few chunks
+  static bool HashFile( const std::filesystem::path&, Digest&, bool withSha256 = false );
+
   bool Delete( bool bRecycle = true ) const;
+  static bool DeleteFiles( std::span<const std::filesystem::path>, bool bRecycle = true );
+  static bool Replace( const std::filesystem::path& source, 
+                       const std::filesystem::path& target );
+  static bool Copy( const std::filesystem::path& source, 
+                    const std::filesystem::path& target, const CopyOptions& );
+  static bool Copy( const std::filesystem::path& source, 
+                    const std::filesystem::path& target ) {
+    return Copy( source, target, CopyOptions() );
+  }
 
   void SetFile( const std::filesystem::path& path ) {
     Close();
@@ -102,11 +241,285 @@ public:
     return path_;
   }
 
+  // Also record this file's operations into stats, which must outlive the
+  // File; nullptr stops. Global FileStats are recorded independently.
+  void SetStats( FileStats* stats ) {
+    stats_ = stats;
+  }
+
+  FileStats* GetStats() const {
+    return stats_;
+  }
+
+  FileFlags GetFlags() const {
+    return flags_;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Heap buffer with a fixed alignment whose capacity is rounded up to a whole
+  // number of alignment units. size() is the number of meaningful bytes, which
+  // may be less than capacity(). Memory is not initialized.
+
+  class AlignedBuffer
+  {
+  public:
+
+    AlignedBuffer() = default;
+
+    AlignedBuffer( size_t bytes, size_t alignment ) :
+      alignment_( alignment )
+    {
+      assert( alignment > 0 && ( alignment & ( alignment - 1 ) ) == 0 ); // power of two
+      if( bytes == 0 )
+        return;
+      auto capacity = ( bytes + alignment - 1 ) & ~( alignment - 1 );
+      data_ = static_cast<std::byte*>( ::operator new( capacity, 
+                                       std::align_val_t{ alignment }, std::nothrow ) );
+      if( data_ != nullptr )
+      {
+        size_ = bytes;
+        capacity_ = capacity;
+      }
+    }
+
+    ~AlignedBuffer() {
+      Free();
+    }
+
+    // Disable copy
+    AlignedBuffer( const AlignedBuffer& ) = delete;
+    AlignedBuffer& operator=( const AlignedBuffer& ) = delete;
+
+    AlignedBuffer( AlignedBuffer&& rhs ) noexcept :
+      data_( std::exchange( rhs.data_, nullptr ) ),
+      size_( std::exchange( rhs.size_, 0u ) ),
+      capacity_( std::exchange( rhs.capacity_, 0u ) ),
+      alignment_( rhs.alignment_ )
+    {
+    }
+
+    AlignedBuffer& operator=( AlignedBuffer&& rhs ) noexcept
+    {
+      if( this != &rhs )
+      {
+        Free();
+        data_ = std::exchange( rhs.data_, nullptr );
+        size_ = std::exchange( rhs.size_, 0u );
+        capacity_ = std::exchange( rhs.capacity_, 0u );
+        alignment_ = rhs.alignment_;
+      }
+      return *this;
+    }
+
+    std::byte* data() { return data_; }
+    const std::byte* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    size_t alignment() const { return alignment_; }
+
+    // Adjust the meaningful byte count without reallocating
+    void resize( size_t bytes )
+    {
+      assert( bytes <= capacity_ );
+      size_ = bytes;
+    }
+
+  private:
+
+    void Free()
+    {
+      if( data_ != nullptr )
+        ::operator delete( data_, std::align_val_t{ alignment_ } );
+      data_ = nullptr;
+      size_ = capacity_ = 0u;
+    }
+
+  private:
+
+    std::byte* data_ = nullptr;
+    size_t     size_ = 0u;
+    size_t     capacity_ = 0u;
+    size_t     alignment_ = alignof( std::max_align_t );
+
+  }; // class AlignedBuffer
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Completion token for a single ReadAsync/WriteAsync. The OS references the
+  // request until the I/O completes, so it must stay alive and in place while
+  // pending; destroying a pending request cancels the I/O and waits for it.
+  // A completed request may be reused for another operation.
+
+  class AsyncRequest
+  {
+  public:
+
+    AsyncRequest();
+    ~AsyncRequest();
+
+    // Disable copy/move
+    AsyncRequest( const AsyncRequest& ) = delete;
+    AsyncRequest& operator=( const AsyncRequest& ) = delete;
+    AsyncRequest( AsyncRequest&& ) = delete;
+    AsyncRequest& operator=( AsyncRequest&& ) = delete;
+
+    bool IsPending() const;
+    bool IsComplete() const;
+    bool Wait();
+    bool Wait( uint32_t& bytesTransferred );
+    void Cancel();
+
+  private:
+
+    friend class File;
+    void Begin( const File&, uint64_t offset, uint32_t bytes, bool isWrite );
+    void Complete( bool success, uint32_t bytesTransferred );
+
+    // Storage for the native OVERLAPPED (Windows) or aiocb (POSIX)
+#if defined(_WIN32)
+    static constexpr size_t kNativeSize = 3 * sizeof( void* ) + sizeof( uint64_t );
+#else
+    static constexpr size_t kNativeSize = 256;
+#endif
+    alignas( std::max_align_t ) std::byte native_[ kNativeSize ];
+
+    void*       event_; // Windows only
+    void*       file_;
+    FileStats*  stats_; // copied from the File so the File may move or close
+    std::filesystem::path path_; // only when timed
+    std::chrono::steady_clock::time_point start_;
+    uint32_t    bytesRequested_;
+    uint32_t    bytesTransferred_;
+    bool        isPending_;
+    bool        success_;
+    bool        isWrite_;
+    bool        isTimed_;
+
+  }; // class AsyncRequest
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Input range over the file in chunks of chunkSize bytes, from the start of
+  // the file to the end. On Async files the next depth chunks are read in the
+  // background while the current chunk is processed; other files read each
+  // chunk on demand. A chunk is valid until the iterator is incremented.
+  //
+  //   for( auto chunk : file.Chunks() )
+  //     Process( chunk );
+
+  class ChunkRange
+  {
+  public:
+
+    struct Sentinel {};
+
+    class Iterator
+    {
+    public:
+      using value_type = std::span<const std::byte>;
+      using difference_type = std::ptrdiff_t;
+
+      value_type operator*() const { return range_->chunk_; }
+      Iterator& operator++() { range_->Advance(); return *this; }
+      void operator++( int ) { range_->Advance(); }
+      bool operator==( Sentinel ) const { return range_->chunk_.empty(); }
+
+    private:
+      friend class ChunkRange;
+      explicit Iterator( ChunkRange* range ) : range_( range ) {}
+      ChunkRange* range_;
+    };
+
+  public:
+
+    ChunkRange( const File&, uint32_t chunkSize, uint32_t depth );
+    ~ChunkRange() = default;
+
+    // Disable copy/move
+    ChunkRange( const ChunkRange& ) = delete;
+    ChunkRange& operator=( const ChunkRange& ) = delete;
+    ChunkRange( ChunkRange&& ) = delete;
+    ChunkRange& operator=( ChunkRange&& ) = delete;
+
+    Iterator begin();
+    Sentinel end() const { return {}; }
+
+    // True if iteration stopped because a read failed rather than at EOF
+    bool HasError() const { return hasError_; }
+
+  private:
+
+    bool Issue( size_t slot );
+    void Advance();
+    void Consume( size_t slot );
+
+  private:
+
+    const File&                     file_;
+    uint32_t                        chunkSize_;
+    uint64_t                        length_;
+    uint64_t                        nextOffset_; // next chunk to issue
+    std::vector<AlignedBuffer>      buffers_;
+    std::unique_ptr<AsyncRequest[]> requests_;   // after buffers_; destroyed first
+    size_t                          current_;    // slot holding chunk_
+    std::span<const std::byte>      chunk_;
+    bool                            hasError_;
+
+  }; // class ChunkRange
+
+  ChunkRange Chunks( uint32_t chunkSize = 1024 * 1024, uint32_t depth = 2 ) const {
+    return ChunkRange( *this, chunkSize, depth );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Read-only memory-mapped view of a file or a sub-range of a file. Pages are
+  // loaded on demand and shared with other processes mapping the same file.
+  // The file must be open with FileFlags::Read; the view remains valid after
+  // the File is closed.
+
+  class MapView
+  {
+  public:
+
+    MapView();
+    ~MapView();
+
+    // Disable copy/move
+    MapView( const MapView& ) = delete;
+    MapView& operator=( const MapView& ) = delete;
+    MapView( MapView&& ) = delete;
+    MapView& operator=( MapView&& ) = delete;
+
+    bool Map( const File&, uint64_t offset = 0,
+              uint64_t length = std::numeric_limits<uint64_t>::max() );
+    void Unmap();
+    bool IsMapped() const;
+
+    // Page in part of the view ahead of use; offset and length are relative
+    // to GetData()
+    bool Prefetch( size_t offset = 0, size_t length = std::numeric_limits<size_t>::max() ) const;
+
+    std::span<const std::byte> GetData() const {
+      return data_;
+    }
+
+  private:
+
+    void*                      view_; // base of the mapped region
+    std::span<const std::byte> data_; // requested range within the region
+
+  }; // class MapView
+
   ///////////////////////////////////////////////////////////////////////////////
   //
   // Open, read entire file into memory, and close. T must support resize() and
   // data() functions, e.g. string, vector, etc. Returns false if file can't be
-  // opened or insufficient memory. TODO enable concepts
+  // opened or insufficient memory. Large files are read in chunks of
+  // GetIoChunkSize() bytes. Types with resize_and_overwrite(), e.g. string and
+  // pmr::string, are filled without first zeroing the buffer.
+  // TODO enable concepts
 
   template <class T>
   static bool ReadEntireFile( const std::filesystem::path& path, T& result )
@@ -118,28 +531,99 @@ public:
 
     // Create buffer the size of the file
     auto len = f.GetLength();
-    if( len > std::numeric_limits<uint32_t>::max() )
+    if( len > std::numeric_limits<size_t>::max() )
+      return false;
+    auto size = static_cast<size_t>( len );
+
+    // Read file into memory
+    if constexpr( requires { result.resize_and_overwrite( size, []( auto*, size_t n ) { return n; } ); } )
+    {
+      bool success = false;
+      try
+      {
+        result.resize_and_overwrite( size, [&]( auto* pBuffer, size_t n )
+        {
+          success = f.Read( pBuffer, n );
+          return success ? n : 0u;
+        } );
+      }
+      catch( std::bad_alloc& )
+      {
+        return false;
+      }
+      return success;
+    }
+    else
+    {
+      try { result.resize( size ); }
+      catch( std::bad_alloc& )
+      {
+        return false;
+      }
+
+      if( !f.Read( result.data(), len ) )
+      {
+        result.resize( 0 );
+        return false;
+      }
+      return true;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Open, read entire file into uninitialized memory from the given resource,
+  // and close. Use a monotonic_buffer_resource or a custom memory_resource to
+  // read into an arena with no global heap allocation. On success the caller
+  // owns result and releases it with
+  // resource.deallocate( result.data(), result.size(), alignof( std::max_align_t ) ).
+  // Empty files succeed without allocating.
+
+  static bool ReadEntireFile( const std::filesystem::path& path, 
+                              std::pmr::memory_resource& resource, 
+                              std::span<std::byte>& result )
+  {
+    result = {};
+    File f( path );
+    if( !f.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SequentialScan ) )
+      return false;
+
+    auto len = f.GetLength();
+    if( len > std::numeric_limits<size_t>::max() )
       return false;
-    auto len32 = static_cast<uint32_t>( len );
-    try { result.resize( len32 ); }
+    auto size = static_cast<size_t>( len );
+    if( size == 0 )
+      return true;
+
+    void* pBuffer = nullptr;
+    try { pBuffer = resource.allocate( size, alignof( std::max_align_t ) ); }
     catch( std::bad_alloc& )
     {
       return false;
     }
 
-    // Read file into memory
-    if( !f.Read( result.data(), len32 ) )
+    if( !f.Read( pBuffer, len ) )
     {
-      result.resize( 0 );
+      resource.deallocate( pBuffer, size, alignof( std::max_align_t ) );
       return false;
     }
+    result = { static_cast<std::byte*>( pBuffer ), size };
     return true;
   }
 
+  // Open with FileFlags::Unbuffered, read the entire file into a sector-aligned
+  // buffer, and close. Streams large files without evicting the system cache.
+  static bool ReadEntireFile( const std::filesystem::path&, AlignedBuffer& );
+
 private:
 
+  friend class FileIoScheduler;
+  friend class DirectoryWatcher;
+
   std::filesystem::path path_;
-  void*                 file_;
+  void*                 file_;  // HANDLE on Windows; file descriptor on POSIX
+  FileFlags             flags_;
+  FileStats*            stats_; // optional; see SetStats
 
 }; // class File
 
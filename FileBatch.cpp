@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileBatch.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "FileBatch.h"
+
+using namespace PKIsensee;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Threads claim indices one at a time, so a few large files don't hold up
+// the rest of the batch
+
+void FileBatch::ForEach( size_t count, uint32_t threadCount, 
+                         const std::function<void( size_t )>& fn )
+{
+  if( threadCount == 0 )
+    threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+  threadCount = static_cast<uint32_t>( std::min<size_t>( threadCount, count ) );
+
+  std::atomic<size_t> next = 0u;
+  auto worker = [&]
+  {
+    for( auto i = next++; i < count; i = next++ )
+      fn( i );
+  };
+
+  std::vector<std::thread> threads;
+  if( threadCount > 1 )
+    threads.reserve( threadCount - 1 );
+  for( uint32_t i = 1; i < threadCount; ++i )
+    threads.emplace_back( worker );
+  worker();
+  for( auto& thread : threads )
+    thread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
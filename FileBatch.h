@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileBatch.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Operations over many files at once. Work is spread over a pool of threads
+//  so per-file open and read latency overlaps.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileBatch
+{
+public:
+
+  struct Result
+  {
+    size_t              succeeded = 0u;
+    std::vector<size_t> failed; // indices into the input paths, ascending
+  };
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Read every file into a T with File::ReadEntireFile. onRead(index, contents)
+  // is invoked for each file as soon as it has been read, concurrently from
+  // multiple threads; it may keep the contents by moving from them. Zero
+  // threads uses one per hardware thread. Storage with high latency benefits
+  // from more threads than cores.
+
+  template <class T = std::vector<std::byte>>
+  static Result ReadEntireFiles( std::span<const std::filesystem::path> paths,
+                                 const std::function<void( size_t, std::type_identity_t<T>& )>& onRead,
+                                 uint32_t threadCount = 0 )
+  {
+    Result result;
+    std::mutex mutex;
+    ForEach( paths.size(), threadCount, [&]( size_t i )
+    {
+      T contents;
+      auto success = File::ReadEntireFile( paths[ i ], contents );
+      if( success )
+        onRead( i, contents );
+      std::lock_guard lock( mutex );
+      if( success )
+        ++result.succeeded;
+      else
+        result.failed.push_back( i );
+    } );
+    std::sort( result.failed.begin(), result.failed.end() );
+    return result;
+  }
+
+  // Invoke fn( i ) for i in [0, count) across threads, including the caller's.
+  // Zero threads uses one per hardware thread.
+  static void ForEach( size_t count, uint32_t threadCount, 
+                       const std::function<void( size_t )>& fn );
+
+}; // class FileBatch
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,404 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileBench.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  Benchmarks for the File read, write, metadata and delete paths.
+//
+//  Usage: FileBench [dir] [--max-size bytes] [--cold-only | --warm-only]
+//
+//  Test files are created under dir (default: the temp directory) for sizes
+//  from 4 KB up to --max-size (default 1 GB; 10 GB runs need the disk space).
+//  Cold runs purge the system cache for the file before each measurement,
+//  warm runs read it once first.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BufferedFile.h"
+#include "File.h"
+
+#if defined(_WIN32)
+#define NOMINMAX 1
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+constexpr uint64_t KB = 1024;
+constexpr uint64_t MB = 1024 * KB;
+constexpr uint64_t GB = 1024 * MB;
+
+constexpr uint64_t kSizes[] = { 4 * KB, 64 * KB, 1 * MB, 16 * MB, 256 * MB, 1 * GB, 10 * GB };
+constexpr uint32_t kBlockSize = 64 * KB;
+constexpr uint32_t kRandomReadSize = 4 * KB;
+constexpr uint32_t kRandomReadCount = 2048;
+constexpr uint32_t kRecordSize = 64;
+constexpr uint32_t kMetadataCount = 10000;
+constexpr uint32_t kDeleteCount = 20;
+
+enum class Cache
+{
+  Warm,
+  Cold
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Drop the file's pages from the system cache. Windows purges a file's cached
+// pages when it's opened unbuffered; POSIX is asked directly.
+
+void PurgeCache( const fs::path& path )
+{
+#if defined(_WIN32)
+  auto hFile = ::CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 
+                              NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL );
+  if( hFile != INVALID_HANDLE_VALUE )
+    ::CloseHandle( hFile );
+#else
+  auto fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+  if( fd >= 0 )
+  {
+    ::fdatasync( fd );
+    ::posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    ::close( fd );
+  }
+#endif
+}
+
+void WarmCache( const fs::path& path )
+{
+  File file( path );
+  if( !file.Open( FileFlags::Read | FileFlags::SequentialScan ) )
+    return;
+  std::vector<std::byte> block( kBlockSize );
+  uint32_t bytesRead = 0u;
+  while( file.Read( block.data(), kBlockSize, bytesRead ) && bytesRead > 0 )
+  {
+  }
+}
+
+void PrepareCache( const fs::path& path, Cache cache )
+{
+  if( cache == Cache::Cold )
+    PurgeCache( path );
+  else
+    WarmCache( path );
+}
+
+std::string FormatSize( uint64_t bytes )
+{
+  char text[ 32 ];
+  if( bytes >= GB )
+    std::snprintf( text, sizeof( text ), "%llu GB", static_cast<unsigned long long>( bytes / GB ) );
+  else if( bytes >= MB )
+    std::snprintf( text, sizeof( text ), "%llu MB", static_cast<unsigned long long>( bytes / MB ) );
+  else
+    std::snprintf( text, sizeof( text ), "%llu KB", static_cast<unsigned long long>( bytes / KB ) );
+  return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Time fn once and print one result row. Throughput is reported when bytes is
+// non-zero, per-operation latency when ops is.
+
+void Measure( const char* name, uint64_t fileSize, const char* mode, uint64_t bytes, 
+              uint64_t ops, const std::function<bool()>& fn )
+{
+  auto start = std::chrono::steady_clock::now();
+  auto success = fn();
+  auto elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+  std::printf( "%-28s %8s  %-18s %10.3f ms", name, FormatSize( fileSize ).c_str(), mode, 
+               elapsed * 1000.0 );
+  if( bytes > 0 && elapsed > 0.0 )
+    std::printf( "  %10.1f MB/s", static_cast<double>( bytes ) / MB / elapsed );
+  else
+    std::printf( "  %15s", "" );
+  if( ops > 0 )
+    std::printf( "  %10.3f us/op", elapsed * 1e6 / static_cast<double>( ops ) );
+  std::printf( "%s\n", success ? "" : "  FAILED" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Create a file of the given size filled with pseudo-random data, so storage
+// compression doesn't flatter the results. Reused if already present.
+
+bool CreateTestFile( const fs::path& path, uint64_t size )
+{
+  if( File( path ).GetLength() == size )
+    return true;
+
+  File file( path );
+  if( !file.Create( FileFlags::Write | FileFlags::SequentialScan ) )
+    return false;
+  file.Reserve( size );
+
+  std::vector<uint64_t> block( 4 * MB / sizeof( uint64_t ) );
+  std::mt19937_64 rng( size );
+  for( uint64_t written = 0; written < size; )
+  {
+    for( auto& value : block )
+      value = rng();
+    auto bytes = std::min<uint64_t>( size - written, block.size() * sizeof( uint64_t ) );
+    if( !file.Write( block.data(), bytes ) )
+      return false;
+    written += bytes;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks
+
+void BenchReadEntireFile( const fs::path& path, uint64_t size, Cache cache, const char* mode )
+{
+  if( size > 1 * GB && sizeof( size_t ) < 8 )
+    return;
+
+  PrepareCache( path, cache );
+  Measure( "ReadEntireFile vector", size, mode, size, 0, [&]
+  {
+    std::vector<std::byte> contents;
+    return File::ReadEntireFile( path, contents );
+  } );
+
+  PrepareCache( path, cache );
+  Measure( "ReadEntireFile unbuffered", size, mode, size, 0, [&]
+  {
+    File::AlignedBuffer contents;
+    return File::ReadEntireFile( path, contents );
+  } );
+}
+
+void BenchSequentialRead( const fs::path& path, uint64_t size, Cache cache, const char* mode )
+{
+  for( auto hint : { FileFlags::SequentialScan, FileFlags::RandomAccess } )
+  {
+    PrepareCache( path, cache );
+    auto name = ( hint == FileFlags::SequentialScan ) ? "Read seq, SequentialScan" : 
+                                                        "Read seq, RandomAccess";
+    Measure( name, size, mode, size, 0, [&]
+    {
+      File file( path );
+      if( !file.Open( FileFlags::Read | hint ) )
+        return false;
+      std::vector<std::byte> block( kBlockSize );
+      uint64_t total = 0u;
+      uint32_t bytesRead = 0u;
+      while( file.Read( block.data(), kBlockSize, bytesRead ) && bytesRead > 0 )
+        total += bytesRead;
+      return total == size;
+    } );
+  }
+}
+
+void BenchRandomRead( const fs::path& path, uint64_t size, Cache cache, const char* mode )
+{
+  if( size < kRandomReadSize * 4 )
+    return;
+
+  // Same offsets for both hints
+  std::vector<uint64_t> offsets( kRandomReadCount );
+  std::mt19937_64 rng( 42 );
+  std::uniform_int_distribution<uint64_t> pick( 0, size / kRandomReadSize - 1 );
+  for( auto& offset : offsets )
+    offset = pick( rng ) * kRandomReadSize;
+
+  for( auto hint : { FileFlags::SequentialScan, FileFlags::RandomAccess } )
+  {
+    PrepareCache( path, cache );
+    auto name = ( hint == FileFlags::SequentialScan ) ? "Read 4K random, SeqScan" : 
+                                                        "Read 4K random, RandomAcc";
+    Measure( name, size, mode, uint64_t( kRandomReadCount ) * kRandomReadSize, kRandomReadCount, [&]
+    {
+      File file( path );
+      if( !file.Open( FileFlags::Read | hint ) )
+        return false;
+      std::vector<std::byte> block( kRandomReadSize );
+      auto success = true;
+      for( auto offset : offsets )
+        success = file.ReadAt( offset, block.data(), kRandomReadSize ) && success;
+      return success;
+    } );
+  }
+}
+
+void BenchSmallWrites( const fs::path& dir, uint64_t size )
+{
+  // Writing gigabytes in 64-byte records takes minutes; cap it
+  if( size > 256 * MB )
+    return;
+
+  auto path = dir / "records.bin";
+  auto records = size / kRecordSize;
+  std::vector<std::byte> record( kRecordSize, std::byte( 0x5A ) );
+
+  Measure( "Write 64B records", size, "File::Write", size, records, [&]
+  {
+    File file( path );
+    if( !file.Create( FileFlags::Write | FileFlags::SequentialScan ) )
+      return false;
+    auto success = true;
+    for( uint64_t i = 0; i < records; ++i )
+      success = file.Write( record.data(), kRecordSize ) && success;
+    return success;
+  } );
+
+  Measure( "Write 64B records", size, "BufferedFile", size, records, [&]
+  {
+    File file( path );
+    if( !file.Create( FileFlags::Write | FileFlags::SequentialScan ) )
+      return false;
+    BufferedFileWriter writer( file );
+    auto success = true;
+    for( uint64_t i = 0; i < records; ++i )
+      success = writer.Write( record.data(), kRecordSize ) && success;
+    return writer.FlushBuffer() && success;
+  } );
+  File( path ).Delete( false );
+}
+
+void BenchMetadata( const fs::path& path, uint64_t size )
+{
+  File closed( path );
+  File open( path );
+  if( !open.Open( FileFlags::Read | FileFlags::SharedRead ) )
+    return;
+
+  for( auto* pFile : { &open, &closed } )
+  {
+    auto& file = *pFile;
+    auto mode = file.IsOpen() ? "open" : "closed";
+    Measure( "GetLength", size, mode, 0, kMetadataCount, [&]
+    {
+      uint64_t total = 0u;
+      for( uint32_t i = 0; i < kMetadataCount; ++i )
+        total += file.GetLength();
+      return total == size * kMetadataCount;
+    } );
+    Measure( "GetFileTimes", size, mode, 0, kMetadataCount, [&]
+    {
+      auto success = true;
+      File::Times times;
+      for( uint32_t i = 0; i < kMetadataCount; ++i )
+        success = file.GetFileTimes( times ) && success;
+      return success;
+    } );
+    Measure( "GetInfo", size, mode, 0, kMetadataCount, [&]
+    {
+      auto success = true;
+      File::Info info;
+      for( uint32_t i = 0; i < kMetadataCount; ++i )
+        success = file.GetInfo( info ) && success;
+      return success;
+    } );
+  }
+}
+
+void BenchDelete( const fs::path& dir, uint64_t size )
+{
+  // Recycling big files measures the shell more than File
+  if( size > 16 * MB )
+    return;
+
+  for( auto recycle : { false, true } )
+  {
+    std::vector<fs::path> paths;
+    for( uint32_t i = 0; i < kDeleteCount; ++i )
+    {
+      paths.push_back( dir / ( "delete" + std::to_string( i ) + ".bin" ) );
+      if( !CreateTestFile( paths.back(), size ) )
+        return;
+    }
+    Measure( "Delete", size, recycle ? "recycle" : "permanent", 0, kDeleteCount, [&]
+    {
+      auto success = true;
+      for( const auto& path : paths )
+        success = File( path ).Delete( recycle ) && success;
+      return success;
+    } );
+  }
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char* argv[] )
+{
+  fs::path dir = fs::temp_directory_path() / "FileBench";
+  uint64_t maxSize = 1 * GB;
+  auto isWarm = true;
+  auto isCold = true;
+  for( int i = 1; i < argc; ++i )
+  {
+    std::string_view arg( argv[ i ] );
+    if( arg == "--max-size" && i + 1 < argc )
+      maxSize = std::strtoull( argv[ ++i ], nullptr, 10 );
+    else if( arg == "--cold-only" )
+      isWarm = false;
+    else if( arg == "--warm-only" )
+      isCold = false;
+    else
+      dir = arg;
+  }
+  dir /= "";
+  fs::create_directories( dir );
+
+  for( auto size : kSizes )
+  {
+    if( size > maxSize )
+      break;
+    auto path = dir / ( "bench" + std::to_string( size ) + ".bin" );
+    if( !CreateTestFile( path, size ) )
+    {
+      std::printf( "Failed to create %s test file\n", FormatSize( size ).c_str() );
+      return 1;
+    }
+
+    for( auto cache : { Cache::Warm, Cache::Cold } )
+    {
+      if( ( cache == Cache::Warm && !isWarm ) || ( cache == Cache::Cold && !isCold ) )
+        continue;
+      auto mode = ( cache == Cache::Warm ) ? "warm" : "cold";
+      BenchReadEntireFile( path, size, cache, mode );
+      BenchSequentialRead( path, size, cache, mode );
+      BenchRandomRead( path, size, cache, mode );
+    }
+    BenchSmallWrites( dir, size );
+    BenchMetadata( path, size );
+    BenchDelete( dir, size );
+    std::printf( "\n" );
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileChunks.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  File::ChunkRange; portable, built on the File read API
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include "File.h"
+
+using namespace PKIsensee;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor. Allocates one buffer per chunk in flight plus the one being consumed.
+
+File::ChunkRange::ChunkRange( const File& file, uint32_t chunkSize, uint32_t depth ) :
+  file_( file ),
+  chunkSize_( std::max( chunkSize, 1u ) ),
+  length_( 0u ),
+  nextOffset_( 0u ),
+  buffers_(),
+  requests_(),
+  current_( 0u ),
+  chunk_(),
+  hasError_( false )
+{
+  assert( file.IsOpen() );
+  auto flags = file.GetFlags();
+
+  // Unbuffered reads must be whole sectors
+  if( flags & FileFlags::Unbuffered )
+  {
+    auto sectorSize = file.GetSectorSize();
+    chunkSize_ = ( ( chunkSize_ + sectorSize - 1 ) / sectorSize ) * sectorSize;
+  }
+
+  bool isAsync = flags & FileFlags::Async;
+  size_t slots = isAsync ? size_t( depth ) + 1 : 1u;
+  buffers_.reserve( slots );
+  for( size_t i = 0; i < slots; ++i )
+  {
+    buffers_.push_back( file.AllocateAligned( chunkSize_ ) );
+    if( buffers_.back().data() == nullptr )
+      hasError_ = true;
+    buffers_.back().resize( 0 );
+  }
+  if( isAsync )
+    requests_ = std::make_unique<AsyncRequest[]>( slots );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Start reading. The range is single pass.
+
+File::ChunkRange::Iterator File::ChunkRange::begin()
+{
+  assert( nextOffset_ == 0 );
+  if( !hasError_ )
+  {
+    length_ = file_.GetLength();
+    for( size_t slot = 0; slot < buffers_.size(); ++slot )
+    {
+      if( !Issue( slot ) )
+        break;
+    }
+    current_ = 0u;
+    Consume( current_ );
+  }
+  return Iterator( this );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Start the next chunk read into the given slot. Async reads are left in
+// flight; synchronous reads complete here. Returns false at EOF or on error,
+// leaving the slot empty.
+
+bool File::ChunkRange::Issue( size_t slot )
+{
+  auto& buffer = buffers_[ slot ];
+  buffer.resize( 0 );
+  if( hasError_ || nextOffset_ >= length_ )
+    return false;
+
+  auto offset = nextOffset_;
+  nextOffset_ += chunkSize_;
+  if( requests_ )
+  {
+    if( !file_.ReadAsync( offset, buffer.data(), chunkSize_, requests_[ slot ] ) )
+      hasError_ = true;
+  }
+  else
+  {
+    uint32_t bytesRead = 0u;
+    if( file_.ReadAt( offset, buffer.data(), chunkSize_, bytesRead ) )
+      buffer.resize( bytesRead );
+    else
+      hasError_ = true;
+  }
+  return !hasError_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Refill the slot just consumed with the chunk after those already in flight,
+// then move to the next chunk in file order
+
+void File::ChunkRange::Advance()
+{
+  Issue( current_ );
+  current_ = ( current_ + 1 ) % buffers_.size();
+  Consume( current_ );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Make the slot's chunk current, waiting for its read if necessary. An empty
+// chunk ends the iteration.
+
+void File::ChunkRange::Consume( size_t slot )
+{
+  auto& buffer = buffers_[ slot ];
+  if( requests_ && requests_[ slot ].IsPending() )
+  {
+    uint32_t bytesRead = 0u;
+    if( requests_[ slot ].Wait( bytesRead ) )
+      buffer.resize( bytesRead );
+    else
+      hasError_ = true;
+  }
+  chunk_ = { buffer.data(), buffer.size() };
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileCommon.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  Platform-independent parts of File, built on the native implementations in
+//  File.cpp (Windows) and FilePosix.cpp (POSIX)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include "File.h"
+#include "FileBatch.h"
+#include "FileStats.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+// Large transfers are split into native calls of at most this many bytes
+constexpr uint32_t kChunkAlignment = 64 * 1024;
+std::atomic<uint32_t> sIoChunkSize = 8 * 1024 * 1024;
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read a buffer from the current file position. Buffers larger than the I/O
+// chunk size are read with multiple calls.
+
+bool File::Read( void* pBuffer, uint64_t bytes ) const
+{
+  auto chunkSize = GetIoChunkSize();
+  auto pDest = static_cast<uint8_t*>( pBuffer );
+  while( bytes > 0 )
+  {
+    auto chunk = static_cast<uint32_t>( std::min<uint64_t>( bytes, chunkSize ) );
+    uint32_t bytesRead = 0;
+    auto success = Read( pDest, chunk, bytesRead );
+    if( !success || ( chunk != bytesRead ) )
+      return false;
+    pDest += chunk;
+    bytes -= chunk;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read a buffer from the given file offset
+
+bool File::ReadAt( uint64_t offset, void* pBuffer, uint32_t bytes ) const
+{
+  uint32_t bytesRead = 0;
+  auto success = ReadAt( offset, pBuffer, bytes, bytesRead );
+  return ( success && ( bytes == bytesRead ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Prefetch each file in full. Opening is the slow part for many small files,
+// which is why this is spread over threads.
+
+bool File::PrefetchFiles( std::span<const fs::path> paths, uint32_t threadCount )
+{
+  std::atomic<bool> success = true;
+  FileBatch::ForEach( paths.size(), threadCount, [&]( size_t i )
+  {
+    File file( paths[ i ] );
+    if( !file.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SharedWrite ) || 
+        !file.Prefetch() )
+      success = false;
+  } );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Allocate an uninitialized buffer suitable for unbuffered I/O on this file.
+// The buffer is empty if memory is exhausted.
+
+File::AlignedBuffer File::AllocateAligned( size_t bytes ) const
+{
+  return AlignedBuffer( bytes, GetSectorSize() );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Tune the largest single native read/write. Applies to all files.
+
+void File::SetIoChunkSize( uint32_t bytes )
+{
+  // Round down to alignment, but never below one aligned unit
+  bytes -= bytes % kChunkAlignment;
+  sIoChunkSize = std::max( bytes, kChunkAlignment );
+}
+
+uint32_t File::GetIoChunkSize()
+{
+  return sIoChunkSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read the entire file bypassing the system cache. Reads are whole sectors, so
+// the final read runs into the buffer's padding and returns short at EOF.
+
+bool File::ReadEntireFile( const fs::path& path, AlignedBuffer& result )
+{
+  File f( path );
+  if( !f.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SequentialScan |
+               FileFlags::Unbuffered ) )
+    return false;
+
+  auto len = f.GetLength();
+  if( len > std::numeric_limits<size_t>::max() )
+    return false;
+  result = f.AllocateAligned( static_cast<size_t>( len ) );
+  if( result.size() != len )
+    return false;
+
+  // Chunk size is a multiple of 64K, so every chunk is whole sectors
+  auto chunkSize = GetIoChunkSize();
+  size_t pos = 0u;
+  while( pos < result.size() )
+  {
+    auto chunk = static_cast<uint32_t>( std::min<size_t>( result.capacity() - pos, chunkSize ) );
+    uint32_t bytesRead = 0u;
+    if( !f.Read( result.data() + pos, chunk, bytesRead ) || bytesRead == 0 )
+    {
+      result = AlignedBuffer();
+      return false;
+    }
+    pos += bytesRead;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// MapView
+
+File::MapView::MapView() :
+  view_( nullptr ),
+  data_()
+{
+}
+
+File::MapView::~MapView()
+{
+  Unmap();
+}
+
+bool File::MapView::IsMapped() const
+{
+  return( view_ != nullptr );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AsyncRequest
+
+void File::AsyncRequest::Complete( bool success, uint32_t bytesTransferred )
+{
+  isPending_ = false;
+  success_ = success;
+  bytesTransferred_ = bytesTransferred;
+
+  // Latency runs from issue to completion being observed
+  if( isTimed_ )
+  {
+    isTimed_ = false;
+    FileStats::Done( stats_, isWrite_ ? FileOp::Write : FileOp::Read, path_,
+                     bytesTransferred, FileStats::Timer::Elapsed( start_ ), success );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// True if an operation has been issued and not yet waited on
+
+bool File::AsyncRequest::IsPending() const
+{
+  return isPending_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Block until the operation completes. Returns true if every requested byte
+// was transferred.
+
+bool File::AsyncRequest::Wait()
+{
+  uint32_t bytesTransferred = 0u;
+  return( Wait( bytesTransferred ) && ( bytesTransferred == bytesRequested_ ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
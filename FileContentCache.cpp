@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileContentCache.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include "FileContentCache.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+FileContentCache::FileContentCache( size_t byteBudget ) :
+  mutex_(),
+  entries_(),
+  lru_(),
+  budget_( byteBudget ),
+  size_( 0u )
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Serve cached contents if the file is unchanged, otherwise (re)read it.
+// The read happens outside the lock, so slow files don't block lookups of
+// other files. Metadata is captured before reading; a write that lands
+// during the read updates the write time, so the next Get rereads.
+
+FileContentCache::Contents FileContentCache::Get( const fs::path& path )
+{
+  File::Info info;
+  if( !File( path ).GetInfo( info ) || info.isDirectory )
+  {
+    Invalidate( path );
+    return nullptr;
+  }
+
+  {
+    std::lock_guard lock( mutex_ );
+    auto it = entries_.find( path );
+    if( it != entries_.end() )
+    {
+      if( IsCurrent( it->second, info ) )
+      {
+        lru_.splice( lru_.begin(), lru_, it->second.lruPos );
+        return it->second.contents;
+      }
+      Erase( it );
+    }
+  }
+
+  auto contents = std::make_shared<std::vector<std::byte>>();
+  if( !File::ReadEntireFile( path, *contents ) )
+    return nullptr;
+
+  std::lock_guard lock( mutex_ );
+  if( contents->size() > budget_ )
+    return contents;
+
+  // Another thread may have loaded the file while we were reading
+  auto it = entries_.find( path );
+  if( it != entries_.end() )
+    Erase( it );
+
+  lru_.push_front( path );
+  Entry entry = { contents, info.length, info.times.lastWriteTime, info.fileId, lru_.begin() };
+  entries_.emplace( path, std::move( entry ) );
+  size_ += contents->size();
+  Trim();
+  return contents;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Drop the cached contents of one file, e.g. on a change notification
+
+void FileContentCache::Invalidate( const fs::path& path )
+{
+  std::lock_guard lock( mutex_ );
+  auto it = entries_.find( path );
+  if( it != entries_.end() )
+    Erase( it );
+}
+
+void FileContentCache::Clear()
+{
+  std::lock_guard lock( mutex_ );
+  entries_.clear();
+  lru_.clear();
+  size_ = 0u;
+}
+
+void FileContentCache::SetBudget( size_t byteBudget )
+{
+  std::lock_guard lock( mutex_ );
+  budget_ = byteBudget;
+  Trim();
+}
+
+size_t FileContentCache::GetBudget() const
+{
+  std::lock_guard lock( mutex_ );
+  return budget_;
+}
+
+size_t FileContentCache::GetSize() const
+{
+  std::lock_guard lock( mutex_ );
+  return size_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Unchanged if the file is the same size, was last written at the same time
+// and is the same file; a replaced file usually differs in all three
+
+bool FileContentCache::IsCurrent( const Entry& entry, const File::Info& info )
+{
+  return entry.length == info.length && 
+         entry.lastWriteTime == info.times.lastWriteTime &&
+         entry.fileId == info.fileId;
+}
+
+// Caller holds the lock
+
+void FileContentCache::Erase( EntryMap::iterator it )
+{
+  assert( size_ >= it->second.contents->size() );
+  size_ -= it->second.contents->size();
+  lru_.erase( it->second.lruPos );
+  entries_.erase( it );
+}
+
+// Evict least recently used contents until within budget. Caller holds the
+// lock.
+
+void FileContentCache::Trim()
+{
+  while( size_ > budget_ && !lru_.empty() )
+  {
+    auto it = entries_.find( lru_.back() );
+    assert( it != entries_.end() );
+    Erase( it );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
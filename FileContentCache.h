@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileContentCache.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Caches whole-file contents in memory for repeated loads, e.g. hot-reloaded
+//  configuration and shader files. Each lookup makes a single metadata query;
+//  the file is only reread when its length, write time or ID changed. The
+//  least recently used contents are evicted to stay within a byte budget.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileContentCache
+{
+public:
+
+  // Shared so callers may keep contents after eviction or reload
+  using Contents = std::shared_ptr<const std::vector<std::byte>>;
+
+public:
+
+  // Files larger than the budget are read but never cached
+  explicit FileContentCache( size_t byteBudget = 64 * 1024 * 1024 );
+  ~FileContentCache() = default;
+
+  // Disable copy/move
+  FileContentCache( const FileContentCache& ) = delete;
+  FileContentCache& operator=( const FileContentCache& ) = delete;
+  FileContentCache( FileContentCache&& ) = delete;
+  FileContentCache& operator=( FileContentCache&& ) = delete;
+
+  // Current contents of the file; nullptr if it can't be read. Safe to call
+  // from multiple threads.
+  Contents Get( const std::filesystem::path& );
+
+  void Invalidate( const std::filesystem::path& );
+  void Clear();
+  void SetBudget( size_t byteBudget );
+
+  size_t GetBudget() const;
+  size_t GetSize() const;  // bytes currently cached
+
+private:
+
+  struct Entry
+  {
+    Contents                                   contents;
+    uint64_t                                   length;
+    File::Time                                 lastWriteTime;
+    uint64_t                                   fileId;
+    std::list<std::filesystem::path>::iterator lruPos;
+  };
+
+  struct PathHash
+  {
+    size_t operator()( const std::filesystem::path& path ) const {
+      return std::filesystem::hash_value( path );
+    }
+  };
+
+  using EntryMap = std::unordered_map<std::filesystem::path, Entry, PathHash>;
+
+  static bool IsCurrent( const Entry&, const File::Info& );
+  void Erase( EntryMap::iterator );
+  void Trim();
+
+private:
+
+  mutable std::mutex               mutex_;
+  EntryMap                         entries_;
+  std::list<std::filesystem::path> lru_;   // most recently used first
+  size_t                           budget_;
+  size_t                           size_;
+
+}; // class FileContentCache
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileCopy.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+#include "File.h"
+#include "Log.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+// One chunk's buffer and the read and write that move it
+struct CopySlot
+{
+  File::AlignedBuffer buffer;
+  File::AsyncRequest  read;
+  File::AsyncRequest  write;
+  uint64_t            offset = 0u;
+};
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copy source to target, replacing target. Reads and writes are overlapped
+// through a ring of chunk buffers: while chunk N is being written, chunks
+// N+1 onward are being read. The target is preallocated to the final
+// length. Unbuffered writes are whole sectors, so the last chunk is padded
+// and the target trimmed afterwards. The last write time and permissions are
+// carried over. A partial target is deleted on failure or cancellation.
+
+bool File::Copy( const fs::path& source, const fs::path& target, const CopyOptions& options )
+{
+  // The length decides how the source is opened
+  File src( source );
+  Info info;
+  if( !src.GetInfo( info ) || info.isDirectory )
+    return false;
+  auto length = info.length;
+
+  auto flags = FileFlags::Async;
+  if( length >= options.unbufferedThreshold )
+    flags = flags | FileFlags::Unbuffered;
+  if( !src.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SequentialScan | flags ) )
+    return false;
+
+  File dst( target );
+  if( !dst.Create( FileFlags::Write | FileFlags::SequentialScan | flags ) )
+    return false;
+
+  auto fail = [&]
+  {
+    dst.Close();
+    dst.Delete( false );
+    return false;
+  };
+
+  // Contiguous allocation up front; not fatal if the file system refuses
+  if( length > 0 )
+    dst.Reserve( length );
+
+  // Chunks must be whole sectors on both files when unbuffered
+  size_t alignment = std::max( src.GetSectorSize(), dst.GetSectorSize() );
+  uint32_t chunkSize = std::max( options.chunkSize, 1u );
+  chunkSize = static_cast<uint32_t>( ( ( chunkSize + alignment - 1 ) / alignment ) * alignment );
+  auto chunkCount = ( length + chunkSize - 1 ) / chunkSize;
+
+  // The ring refills a slot only after the following chunk's write is issued,
+  // so more than one chunk needs at least two slots
+  auto depth = static_cast<size_t>( std::clamp<uint64_t>( chunkCount, 1u, 
+                                                          std::max( options.depth, 2u ) ) );
+
+  auto slots = std::make_unique<CopySlot[]>( depth );
+  for( size_t i = 0; i < depth; ++i )
+  {
+    slots[ i ].buffer = AlignedBuffer( chunkSize, alignment );
+    if( slots[ i ].buffer.data() == nullptr )
+      return fail();
+  }
+
+  // Prime the ring
+  auto success = true;
+  uint64_t nextRead = 0u;
+  auto issueRead = [&]( CopySlot& slot )
+  {
+    if( nextRead >= length )
+      return;
+    slot.offset = nextRead;
+    nextRead += chunkSize;
+    success = src.ReadAsync( slot.offset, slot.buffer.data(), chunkSize, slot.read ) && success;
+  };
+  for( size_t i = 0; i < depth; ++i )
+    issueRead( slots[ i ] );
+
+  // Chunks complete in file order. Once chunk N's write is issued, chunk N-1's
+  // write is waited on and its slot starts reading the next chunk.
+  uint64_t bytesCopied = 0u;
+  for( uint64_t chunk = 0; chunk < chunkCount && success; ++chunk )
+  {
+    auto& slot = slots[ chunk % depth ];
+    uint32_t bytesRead = 0u;
+    auto expected = static_cast<uint32_t>( std::min<uint64_t>( chunkSize, length - slot.offset ) );
+    if( !slot.read.Wait( bytesRead ) || bytesRead != expected )
+    {
+      success = false;
+      break;
+    }
+
+    auto bytesToWrite = bytesRead;
+    if( flags & FileFlags::Unbuffered )
+    {
+      bytesToWrite = static_cast<uint32_t>( ( ( bytesRead + alignment - 1 ) / alignment ) * alignment );
+      std::memset( slot.buffer.data() + bytesRead, 0, bytesToWrite - bytesRead );
+    }
+    success = dst.WriteAsync( slot.offset, slot.buffer.data(), bytesToWrite, slot.write );
+
+    if( chunk > 0 )
+    {
+      auto& prev = slots[ ( chunk - 1 ) % depth ];
+      success = prev.write.Wait() && success;
+      if( success )
+      {
+        bytesCopied += std::min<uint64_t>( chunkSize, length - prev.offset );
+        if( options.progress && !options.progress( bytesCopied, length ) )
+          success = false;
+      }
+      if( success )
+        issueRead( prev );
+    }
+  }
+
+  // Drain; waiting again on a finished or unused request is harmless
+  for( size_t i = 0; i < depth; ++i )
+  {
+    slots[ i ].read.Cancel();
+    slots[ i ].read.Wait();
+  }
+  if( success && chunkCount > 0 )
+  {
+    auto& last = slots[ ( chunkCount - 1 ) % depth ];
+    success = last.write.Wait();
+    if( success )
+    {
+      bytesCopied = length;
+      if( options.progress && !options.progress( bytesCopied, length ) )
+        success = false;
+    }
+  }
+  for( size_t i = 0; i < depth; ++i )
+    slots[ i ].write.Wait();
+
+  // Trim the padding, or the reservation of an empty file
+  if( !success || !dst.SetLength( length ) )
+    return fail();
+  dst.Close();
+
+  std::error_code ec;
+  fs::last_write_time( target, fs::last_write_time( source, ec ), ec );
+  fs::permissions( target, fs::status( source, ec ).permissions(), ec );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
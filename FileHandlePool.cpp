@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileHandlePool.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include "FileHandlePool.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+FileHandlePool::FileHandlePool( size_t capacity ) :
+  capacity_( std::max( capacity, size_t( 1 ) ) ),
+  mutex_(),
+  entries_(),
+  lru_()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Return the pooled file, or open and pool it. Opening happens outside the
+// lock so a slow open doesn't block hits on other files.
+
+std::shared_ptr<File> FileHandlePool::Open( const fs::path& path, FileFlags flags )
+{
+  Key key = { path, flags };
+  key.path.make_preferred(); // match File's own normalization
+  {
+    std::lock_guard lock( mutex_ );
+    auto it = entries_.find( key );
+    if( it != entries_.end() )
+    {
+      lru_.splice( lru_.begin(), lru_, it->second.lruPos );
+      return it->second.file;
+    }
+  }
+
+  auto file = std::make_shared<File>( key.path );
+  if( !file->Open( flags ) )
+    return nullptr;
+
+  std::lock_guard lock( mutex_ );
+
+  // Another thread may have opened the same file meanwhile; share theirs
+  auto it = entries_.find( key );
+  if( it != entries_.end() )
+  {
+    lru_.splice( lru_.begin(), lru_, it->second.lruPos );
+    return it->second.file;
+  }
+
+  lru_.push_front( key );
+  entries_.emplace( std::move( key ), Entry{ file, lru_.begin() } );
+  while( entries_.size() > capacity_ )
+    Erase( entries_.find( lru_.back() ) );
+  return file;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Drop all handles for the path, whatever their flags
+
+void FileHandlePool::Evict( const fs::path& path )
+{
+  auto preferred = path;
+  preferred.make_preferred();
+  std::lock_guard lock( mutex_ );
+  std::erase_if( entries_, [&]( const auto& entry )
+  {
+    if( entry.first.path != preferred )
+      return false;
+    lru_.erase( entry.second.lruPos );
+    return true;
+  } );
+}
+
+void FileHandlePool::Clear()
+{
+  std::lock_guard lock( mutex_ );
+  entries_.clear();
+  lru_.clear();
+}
+
+size_t FileHandlePool::GetCount() const
+{
+  std::lock_guard lock( mutex_ );
+  return entries_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Caller holds the lock. The file closes when the last holder releases it.
+
+void FileHandlePool::Erase( EntryMap::iterator it )
+{
+  lru_.erase( it->second.lruPos );
+  entries_.erase( it );
+}
+
+///////////////////////////////////////////////////////////////////////////////
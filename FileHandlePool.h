@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileHandlePool.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Keeps recently used files open so repeated opens of the same path and flags
+//  reuse the handle instead of paying for CreateFileW or open each time. The
+//  least recently used handle is closed once the pool is full.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileHandlePool
+{
+public:
+
+  explicit FileHandlePool( size_t capacity = 64 );
+  ~FileHandlePool() = default;
+
+  // Disable copy/move
+  FileHandlePool( const FileHandlePool& ) = delete;
+  FileHandlePool& operator=( const FileHandlePool& ) = delete;
+  FileHandlePool( FileHandlePool&& ) = delete;
+  FileHandlePool& operator=( FileHandlePool&& ) = delete;
+
+  // Open file, shared with every other caller using the same path and flags;
+  // nullptr if it can't be opened. Use positional I/O such as ReadAt, since
+  // callers share the file position. A file stays open while pooled or held.
+  std::shared_ptr<File> Open( const std::filesystem::path&, FileFlags );
+
+  // Drop every pooled handle for the path, e.g. before deleting or replacing
+  // it. Callers still holding the file keep it open.
+  void Evict( const std::filesystem::path& );
+  void Clear();
+
+  size_t GetCount() const;
+  size_t GetCapacity() const {
+    return capacity_;
+  }
+
+private:
+
+  struct Key
+  {
+    std::filesystem::path path;
+    FileFlags             flags;
+
+    bool operator==( const Key& ) const = default;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()( const Key& key ) const {
+      using T = std::underlying_type_t<FileFlags>;
+      auto flags = std::hash<T>{}( static_cast<T>( key.flags ) );
+      return std::filesystem::hash_value( key.path ) * 31 + flags;
+    }
+  };
+
+  struct Entry
+  {
+    std::shared_ptr<File>    file;
+    std::list<Key>::iterator lruPos;
+  };
+
+  using EntryMap = std::unordered_map<Key, Entry, KeyHash>;
+
+  void Erase( EntryMap::iterator );
+
+private:
+
+  const size_t       capacity_;
+  mutable std::mutex mutex_;
+  EntryMap           entries_;
+  std::list<Key>     lru_;    // most recently used first
+
+}; // class FileHandlePool
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
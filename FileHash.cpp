@@ -0,0 +1,387 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileHash.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  XxHash64, Sha256, FileHasher and File::HashFile; portable
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include "FileHash.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+// XXH64 primes
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+// SHA-256 round constants
+constexpr uint32_t kRound[ 64 ] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr std::array<uint32_t, 8> kInitialState =
+{
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// HashFile tuning; matches the File::Copy defaults
+constexpr uint32_t kHashChunkSize = 1024 * 1024;
+constexpr uint32_t kHashDepth = 4;
+constexpr uint64_t kUnbufferedThreshold = 64 * 1024 * 1024;
+
+template <typename T>
+T LoadLittle( const std::byte* p )
+{
+  T value;
+  std::memcpy( &value, p, sizeof( value ) );
+  if constexpr( std::endian::native == std::endian::big )
+    value = std::byteswap( value );
+  return value;
+}
+
+template <typename T>
+T LoadBig( const std::byte* p )
+{
+  T value;
+  std::memcpy( &value, p, sizeof( value ) );
+  if constexpr( std::endian::native == std::endian::little )
+    value = std::byteswap( value );
+  return value;
+}
+
+template <typename T>
+void StoreBig( std::byte* p, T value )
+{
+  if constexpr( std::endian::native == std::endian::little )
+    value = std::byteswap( value );
+  std::memcpy( p, &value, sizeof( value ) );
+}
+
+uint64_t Round( uint64_t acc, uint64_t input )
+{
+  acc += input * kPrime2;
+  return std::rotl( acc, 31 ) * kPrime1;
+}
+
+uint64_t MergeRound( uint64_t hash, uint64_t acc )
+{
+  hash ^= Round( 0u, acc );
+  return hash * kPrime1 + kPrime4;
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// XxHash64
+
+XxHash64::XxHash64( uint64_t seed )
+{
+  Reset( seed );
+}
+
+void XxHash64::Reset( uint64_t seed )
+{
+  acc_ = { seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1 };
+  totalLength_ = 0u;
+  seed_ = seed;
+  pendingSize_ = 0u;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Top up any partial stripe, then run whole stripes straight from the input
+// with the accumulators held in locals so they stay in registers
+
+void XxHash64::Update( std::span<const std::byte> data )
+{
+  auto p = data.data();
+  auto remaining = data.size();
+  totalLength_ += remaining;
+
+  if( pendingSize_ > 0 )
+  {
+    auto fill = std::min( remaining, pending_.size() - pendingSize_ );
+    std::memcpy( pending_.data() + pendingSize_, p, fill );
+    pendingSize_ += static_cast<uint32_t>( fill );
+    p += fill;
+    remaining -= fill;
+    if( pendingSize_ < pending_.size() )
+      return;
+    for( size_t i = 0; i < acc_.size(); ++i )
+      acc_[ i ] = Round( acc_[ i ], LoadLittle<uint64_t>( pending_.data() + i * 8 ) );
+    pendingSize_ = 0u;
+  }
+
+  auto v0 = acc_[ 0 ];
+  auto v1 = acc_[ 1 ];
+  auto v2 = acc_[ 2 ];
+  auto v3 = acc_[ 3 ];
+  for( ; remaining >= 32; p += 32, remaining -= 32 )
+  {
+    v0 = Round( v0, LoadLittle<uint64_t>( p ) );
+    v1 = Round( v1, LoadLittle<uint64_t>( p + 8 ) );
+    v2 = Round( v2, LoadLittle<uint64_t>( p + 16 ) );
+    v3 = Round( v3, LoadLittle<uint64_t>( p + 24 ) );
+  }
+  acc_ = { v0, v1, v2, v3 };
+
+  if( remaining > 0 )
+  {
+    std::memcpy( pending_.data(), p, remaining );
+    pendingSize_ = static_cast<uint32_t>( remaining );
+  }
+}
+
+uint64_t XxHash64::GetHash() const
+{
+  uint64_t hash = 0u;
+  if( totalLength_ >= 32 )
+  {
+    hash = std::rotl( acc_[ 0 ], 1 ) + std::rotl( acc_[ 1 ], 7 ) + 
+           std::rotl( acc_[ 2 ], 12 ) + std::rotl( acc_[ 3 ], 18 );
+    for( auto acc : acc_ )
+      hash = MergeRound( hash, acc );
+  }
+  else
+  {
+    hash = seed_ + kPrime5;
+  }
+  hash += totalLength_;
+
+  // Tail of fewer than 32 bytes
+  auto p = pending_.data();
+  auto remaining = size_t( pendingSize_ );
+  for( ; remaining >= 8; p += 8, remaining -= 8 )
+  {
+    hash ^= Round( 0u, LoadLittle<uint64_t>( p ) );
+    hash = std::rotl( hash, 27 ) * kPrime1 + kPrime4;
+  }
+  if( remaining >= 4 )
+  {
+    hash ^= uint64_t( LoadLittle<uint32_t>( p ) ) * kPrime1;
+    hash = std::rotl( hash, 23 ) * kPrime2 + kPrime3;
+    p += 4;
+    remaining -= 4;
+  }
+  for( ; remaining > 0; ++p, --remaining )
+  {
+    hash ^= uint64_t( *p ) * kPrime5;
+    hash = std::rotl( hash, 11 ) * kPrime1;
+  }
+
+  // Avalanche
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Sha256
+
+Sha256::Sha256()
+{
+  Reset();
+}
+
+void Sha256::Reset()
+{
+  state_ = kInitialState;
+  totalLength_ = 0u;
+  pendingSize_ = 0u;
+}
+
+void Sha256::Update( std::span<const std::byte> data )
+{
+  auto p = data.data();
+  auto remaining = data.size();
+  totalLength_ += remaining;
+
+  if( pendingSize_ > 0 )
+  {
+    auto fill = std::min( remaining, pending_.size() - pendingSize_ );
+    std::memcpy( pending_.data() + pendingSize_, p, fill );
+    pendingSize_ += static_cast<uint32_t>( fill );
+    p += fill;
+    remaining -= fill;
+    if( pendingSize_ < pending_.size() )
+      return;
+    Compress( pending_.data() );
+    pendingSize_ = 0u;
+  }
+
+  for( ; remaining >= 64; p += 64, remaining -= 64 )
+    Compress( p );
+
+  if( remaining > 0 )
+  {
+    std::memcpy( pending_.data(), p, remaining );
+    pendingSize_ = static_cast<uint32_t>( remaining );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Pad a copy of the state; this stream is left untouched
+
+Sha256::Hash Sha256::GetHash() const
+{
+  auto final = *this;
+  auto bitLength = totalLength_ * 8;
+
+  std::array<std::byte, 72> padding = {};
+  padding[ 0 ] = std::byte( 0x80 );
+  auto padBytes = ( pendingSize_ < 56 ) ? 56 - pendingSize_ : 120 - pendingSize_;
+  StoreBig( padding.data() + padBytes, bitLength );
+  final.Update( { padding.data(), padBytes + 8 } );
+  assert( final.pendingSize_ == 0 );
+
+  Hash hash;
+  for( size_t i = 0; i < final.state_.size(); ++i )
+    StoreBig( hash.data() + i * 4, final.state_[ i ] );
+  return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Process one 64-byte block. The message schedule is expanded in place over
+// a rolling 16-word window.
+
+void Sha256::Compress( const std::byte* block )
+{
+  std::array<uint32_t, 16> w;
+  for( size_t i = 0; i < w.size(); ++i )
+    w[ i ] = LoadBig<uint32_t>( block + i * 4 );
+
+  auto a = state_[ 0 ];
+  auto b = state_[ 1 ];
+  auto c = state_[ 2 ];
+  auto d = state_[ 3 ];
+  auto e = state_[ 4 ];
+  auto f = state_[ 5 ];
+  auto g = state_[ 6 ];
+  auto h = state_[ 7 ];
+
+  for( size_t i = 0; i < 64; ++i )
+  {
+    if( i >= 16 )
+    {
+      auto w15 = w[ ( i - 15 ) & 15 ];
+      auto w2 = w[ ( i - 2 ) & 15 ];
+      auto s0 = std::rotr( w15, 7 ) ^ std::rotr( w15, 18 ) ^ ( w15 >> 3 );
+      auto s1 = std::rotr( w2, 17 ) ^ std::rotr( w2, 19 ) ^ ( w2 >> 10 );
+      w[ i & 15 ] += s0 + w[ ( i - 7 ) & 15 ] + s1;
+    }
+    auto sum1 = std::rotr( e, 6 ) ^ std::rotr( e, 11 ) ^ std::rotr( e, 25 );
+    auto choice = ( e & f ) ^ ( ~e & g );
+    auto t1 = h + sum1 + choice + kRound[ i ] + w[ i & 15 ];
+    auto sum0 = std::rotr( a, 2 ) ^ std::rotr( a, 13 ) ^ std::rotr( a, 22 );
+    auto majority = ( a & b ) ^ ( a & c ) ^ ( b & c );
+    auto t2 = sum0 + majority;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state_[ 0 ] += a;
+  state_[ 1 ] += b;
+  state_[ 2 ] += c;
+  state_[ 3 ] += d;
+  state_[ 4 ] += e;
+  state_[ 5 ] += f;
+  state_[ 6 ] += g;
+  state_[ 7 ] += h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FileHasher
+
+FileHasher::FileHasher( bool withSha256 ) :
+  xxHash64_(),
+  sha256_(),
+  withSha256_( withSha256 )
+{
+}
+
+void FileHasher::Update( std::span<const std::byte> data )
+{
+  xxHash64_.Update( data );
+  if( withSha256_ )
+    sha256_.Update( data );
+}
+
+File::Digest FileHasher::GetDigest() const
+{
+  File::Digest digest = {};
+  digest.xxh64 = xxHash64_.GetHash();
+  if( withSha256_ )
+    digest.sha256 = sha256_.GetHash();
+  return digest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Hash the file through an Async ChunkRange, so the next chunks are being
+// read while the current one is hashed. Large files are read unbuffered so
+// hashing them doesn't evict the rest of the system cache.
+
+bool File::HashFile( const fs::path& path, Digest& digest, bool withSha256 )
+{
+  File file( path );
+  auto flags = FileFlags::Read | FileFlags::SharedRead | FileFlags::SequentialScan | 
+               FileFlags::Async;
+  if( file.GetLength() >= kUnbufferedThreshold )
+    flags = flags | FileFlags::Unbuffered;
+  if( !file.Open( flags ) )
+    return false;
+
+  FileHasher hasher( withSha256 );
+  auto chunks = file.Chunks( kHashChunkSize, kHashDepth );
+  for( auto chunk : chunks )
+    hasher.Update( chunk );
+  if( chunks.HasError() )
+    return false;
+
+  digest = hasher.GetDigest();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
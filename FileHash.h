@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileHash.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Streaming content hashes: XXH64 for fast lookups and SHA-256 for content
+//  addressing. Both accept data in pieces of any size, so they can be fed
+//  straight from File::Chunks while the next chunk is still being read.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// XXH64, bit-compatible with the reference xxHash implementation. Four
+// independent accumulators consume 32-byte stripes, keeping the multipliers
+// busy in parallel.
+
+class XxHash64
+{
+public:
+
+  explicit XxHash64( uint64_t seed = 0u );
+
+  void Reset( uint64_t seed = 0u );
+  void Update( std::span<const std::byte> );
+
+  // Hash of all data so far; the stream may continue afterwards
+  uint64_t GetHash() const;
+
+private:
+
+  std::array<uint64_t, 4>   acc_;
+  std::array<std::byte, 32> pending_;     // partial stripe
+  uint64_t                  totalLength_;
+  uint64_t                  seed_;
+  uint32_t                  pendingSize_;
+
+}; // class XxHash64
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHA-256 (FIPS 180-4)
+
+class Sha256
+{
+public:
+
+  using Hash = std::array<std::byte, 32>;
+
+  Sha256();
+
+  void Reset();
+  void Update( std::span<const std::byte> );
+
+  // Hash of all data so far; the stream may continue afterwards
+  Hash GetHash() const;
+
+private:
+
+  void Compress( const std::byte* block );
+
+private:
+
+  std::array<uint32_t, 8>   state_;
+  std::array<std::byte, 64> pending_;     // partial block
+  uint64_t                  totalLength_;
+  uint32_t                  pendingSize_;
+
+}; // class Sha256
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Computes a File::Digest over data fed in order, e.g. the chunks of a file
+// being processed anyway:
+//
+//   FileHasher hasher( true );
+//   for( auto chunk : file.Chunks() )
+//   {
+//     hasher.Update( chunk );
+//     Process( chunk );
+//   }
+//   auto digest = hasher.GetDigest();
+
+class FileHasher
+{
+public:
+
+  explicit FileHasher( bool withSha256 = false );
+
+  void Update( std::span<const std::byte> );
+  File::Digest GetDigest() const;
+
+private:
+
+  XxHash64 xxHash64_;
+  Sha256   sha256_;
+  bool     withSha256_;
+
+}; // class FileHasher
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileIoScheduler.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  *** Microsoft Windows implementation ***
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+
+#include <algorithm>
+#include <cassert>
+#include "FileIoScheduler.h"
+#include "File.h"
+#include "Log.h"
+
+// Windows headers
+#define NOMINMAX 1
+#include "Windows.h"
+
+using namespace PKIsensee;
+
+namespace { // anonymous namespace
+
+// Completion keys
+constexpr ULONG_PTR kIoKey = 0;          // I/O completed by the OS
+constexpr ULONG_PTR kIssueFailedKey = 1; // I/O failed before it was queued
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// One read or write. Owned by the completion packet while issued.
+
+struct FileIoScheduler::Operation
+{
+  OVERLAPPED overlapped;
+  HANDLE     file;
+  void*      buffer;
+  uint32_t   bytes;
+  bool       isWrite;
+  DWORD      error;
+  Completion completion;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+FileIoScheduler::FileIoScheduler( uint32_t workerCount, uint32_t maxInFlight ) :
+  port_( NULL ),
+  maxInFlight_( std::max( maxInFlight, 1u ) ),
+  workers_(),
+  executor_(),
+  mutex_(),
+  idle_(),
+  queued_(),
+  inFlight_( 0u ),
+  outstanding_( 0u )
+{
+  if( workerCount == 0 )
+    workerCount = std::max( std::thread::hardware_concurrency(), 1u );
+
+  port_ = ::CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, kIoKey, workerCount );
+  if( port_ == NULL )
+  {
+    PKLOG_WARN( "CreateIoCompletionPort failed with error %d\n", ::GetLastError() );
+    return;
+  }
+
+  workers_.reserve( workerCount );
+  for( uint32_t i = 0; i < workerCount; ++i )
+    workers_.emplace_back( &FileIoScheduler::WorkerThread, this );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor. Completes all outstanding operations before stopping the workers.
+
+FileIoScheduler::~FileIoScheduler()
+{
+  WaitIdle();
+
+  // A packet without an OVERLAPPED tells a worker to exit
+  for( size_t i = 0; i < workers_.size(); ++i )
+    ::PostQueuedCompletionStatus( port_, 0, kIoKey, NULL );
+  for( auto& worker : workers_ )
+    worker.join();
+
+  if( port_ != NULL )
+    ::CloseHandle( port_ );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Bind the file to the completion port. Required once per open file before
+// any Read or Write; the binding lasts until the file is closed.
+
+bool FileIoScheduler::Attach( const File& file )
+{
+  assert( file.IsOpen() );
+  assert( file.GetFlags() & FileFlags::Async );
+  if( port_ == NULL )
+    return false;
+
+  if( ::CreateIoCompletionPort( file.file_, port_, kIoKey, 0 ) == NULL )
+  {
+    PKLOG_WARN( "CreateIoCompletionPort failed to attach file %S with error %d\n",
+                file.path_.c_str(), ::GetLastError() );
+    return false;
+  }
+
+  // Completions are only observed through the port
+  ::SetFileCompletionNotificationModes( file.file_, FILE_SKIP_SET_EVENT_ON_HANDLE );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Queue a read at the given offset. The buffer must remain valid until the
+// completion runs. Returns false only if the scheduler is unusable; I/O errors
+// are reported to the completion.
+
+bool FileIoScheduler::Read( const File& file, uint64_t offset, void* pBuffer, 
+                            uint32_t bytes, Completion completion )
+{
+  assert( file.IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  auto op = std::make_unique<Operation>();
+  ULARGE_INTEGER largeOffset = { .QuadPart = offset };
+  op->overlapped.Offset = largeOffset.LowPart;
+  op->overlapped.OffsetHigh = largeOffset.HighPart;
+  op->file = file.file_;
+  op->buffer = pBuffer;
+  op->bytes = bytes;
+  op->isWrite = false;
+  op->completion = std::move( completion );
+  return Submit( std::move( op ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Queue a write at the given offset. The buffer must remain valid until the
+// completion runs.
+
+bool FileIoScheduler::Write( File& file, uint64_t offset, const void* pBuffer, 
+                             uint32_t bytes, Completion completion )
+{
+  assert( file.IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  auto op = std::make_unique<Operation>();
+  ULARGE_INTEGER largeOffset = { .QuadPart = offset };
+  op->overlapped.Offset = largeOffset.LowPart;
+  op->overlapped.OffsetHigh = largeOffset.HighPart;
+  op->file = file.file_;
+  op->buffer = const_cast<void*>( pBuffer ); // never written through
+  op->bytes = bytes;
+  op->isWrite = true;
+  op->completion = std::move( completion );
+  return Submit( std::move( op ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Block until every submitted operation has completed and its completion has
+// returned
+
+void FileIoScheduler::WaitIdle()
+{
+  std::unique_lock lock( mutex_ );
+  idle_.wait( lock, [this] { return outstanding_ == 0; } );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue now if below the in-flight limit, otherwise queue
+
+bool FileIoScheduler::Submit( std::unique_ptr<Operation> op )
+{
+  if( port_ == NULL )
+    return false;
+  {
+    std::lock_guard lock( mutex_ );
+    ++outstanding_;
+    if( inFlight_ >= maxInFlight_ )
+    {
+      queued_.push_back( std::move( op ) );
+      return true;
+    }
+    ++inFlight_;
+  }
+  Issue( std::move( op ) );
+  return true;
+}
+
+void FileIoScheduler::Issue( std::unique_ptr<Operation> op )
+{
+  // Ownership passes to the completion packet
+  auto pOp = op.release();
+  auto success = pOp->isWrite ?
+    ::WriteFile( pOp->file, pOp->buffer, pOp->bytes, NULL, &pOp->overlapped ) :
+    ::ReadFile( pOp->file, pOp->buffer, pOp->bytes, NULL, &pOp->overlapped );
+  if( success )
+    return;
+
+  auto error = ::GetLastError();
+  if( error == ERROR_IO_PENDING )
+    return;
+
+  // Nothing is queued to the port when the call fails outright, so post a
+  // packet to report the failure from a worker like any other completion
+  pOp->error = error;
+  ::PostQueuedCompletionStatus( port_, 0, kIssueFailedKey, &pOp->overlapped );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dispatch completions until told to exit
+
+void FileIoScheduler::WorkerThread()
+{
+  for( ;; )
+  {
+    DWORD bytes = 0u;
+    ULONG_PTR key = 0u;
+    OVERLAPPED* pOverlapped = nullptr;
+    auto success = ::GetQueuedCompletionStatus( port_, &bytes, &key, &pOverlapped, INFINITE );
+    if( pOverlapped == nullptr )
+      return;
+
+    std::unique_ptr<Operation> op( CONTAINING_RECORD( pOverlapped, Operation, overlapped ) );
+    DWORD error = success ? ERROR_SUCCESS : ::GetLastError();
+    if( key == kIssueFailedKey )
+      error = op->error;
+
+    // Reading at or past the end of the file isn't a failure
+    bool succeeded = ( error == ERROR_SUCCESS ) ||
+                     ( error == ERROR_HANDLE_EOF && !op->isWrite );
+    Finish( std::move( op ), succeeded, bytes );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run the completion and hand the freed slot to the next queued operation
+
+void FileIoScheduler::Finish( std::unique_ptr<Operation> op, bool succeeded, uint32_t bytes )
+{
+  if( op->completion )
+    op->completion( succeeded, bytes );
+  op.reset();
+
+  std::unique_ptr<Operation> next;
+  {
+    std::lock_guard lock( mutex_ );
+    if( !queued_.empty() )
+    {
+      next = std::move( queued_.front() );
+      queued_.pop_front();
+    }
+    else
+    {
+      --inFlight_;
+    }
+    if( --outstanding_ == 0 )
+      idle_.notify_all();
+  }
+  if( next )
+    Issue( std::move( next ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _WIN32
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileIoScheduler.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Drives overlapped I/O for many files through a single I/O completion port
+//  and a small pool of worker threads. Files must be opened with
+//  FileFlags::Async. On Linux the port is an io_uring ring; where io_uring is
+//  unavailable the workers perform the I/O themselves. Operations can also be
+//  awaited from C++20 coroutines.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include "File.h"
+#include "FileTask.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileIoScheduler
+{
+public:
+
+  // Invoked on a worker thread when an operation finishes. Reads that reach
+  // the end of the file succeed with fewer bytes than requested.
+  using Completion = std::function<void( bool success, uint32_t bytesTransferred )>;
+
+  // Resumes a coroutine whose operation finished, e.g. by posting it to a task
+  // system. Without one, coroutines resume on the worker thread.
+  using Executor = std::function<void( std::coroutine_handle<> )>;
+
+  struct Result
+  {
+    bool     success;
+    uint32_t bytesTransferred;
+  };
+
+  class Awaitable;
+
+public:
+
+  // Zero workers uses one per hardware thread. At most maxInFlight operations
+  // are issued to the OS at once; the rest wait in submission order.
+  explicit FileIoScheduler( uint32_t workerCount = 0, uint32_t maxInFlight = 64 );
+  ~FileIoScheduler();
+
+  // Disable copy/move
+  FileIoScheduler( const FileIoScheduler& ) = delete;
+  FileIoScheduler& operator=( const FileIoScheduler& ) = delete;
+  FileIoScheduler( FileIoScheduler&& ) = delete;
+  FileIoScheduler& operator=( FileIoScheduler&& ) = delete;
+
+  bool Attach( const File& );
+  bool Read( const File&, uint64_t offset, void*, uint32_t, Completion );
+  bool Write( File&, uint64_t offset, const void*, uint32_t, Completion );
+  void WaitIdle();
+
+  // Set before awaiting any operation
+  void SetExecutor( Executor executor ) {
+    executor_ = std::move( executor );
+  }
+
+  // Awaitable forms of Read and Write: co_await yields a Result. Coroutines
+  // resumed on a worker thread must not block it, e.g. in WaitIdle().
+  Awaitable ReadAsync( const File&, uint64_t offset, void*, uint32_t );
+  Awaitable WriteAsync( File&, uint64_t offset, const void*, uint32_t );
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Awaitable File::ReadEntireFile. Opens the file for Async reads, attaches
+  // it and reads it in chunks of File::GetIoChunkSize() bytes. T must support
+  // resize() and data() and stay alive until the task completes; types with
+  // resize_and_overwrite() are sized without first zeroing the buffer. On
+  // failure result is emptied. The path is copied, so the task may outlive it.
+
+  template <class T>
+  FileTask<bool> ReadEntireFileAsync( std::filesystem::path path, T& result )
+  {
+    File file( path );
+    if( !file.Open( FileFlags::Read | FileFlags::SharedRead | FileFlags::SequentialScan | 
+                    FileFlags::Async ) || !Attach( file ) )
+    {
+      result.resize( 0 );
+      co_return false;
+    }
+
+    auto len = file.GetLength();
+    if( len > std::numeric_limits<size_t>::max() )
+    {
+      result.resize( 0 );
+      co_return false;
+    }
+    auto size = static_cast<size_t>( len );
+
+    // The reads are issued outside resize_and_overwrite, which must not
+    // suspend; the buffer is left uninitialized until they fill it
+    try
+    {
+      if constexpr( requires { result.resize_and_overwrite( size, []( auto*, size_t n ) { return n; } ); } )
+        result.resize_and_overwrite( size, []( auto*, size_t n ) { return n; } );
+      else
+        result.resize( size );
+    }
+    catch( std::bad_alloc& )
+    {
+      result.resize( 0 );
+      co_return false;
+    }
+
+    auto pDest = reinterpret_cast<std::byte*>( result.data() );
+    for( uint64_t offset = 0u; offset < len; )
+    {
+      auto bytes = static_cast<uint32_t>( std::min<uint64_t>( len - offset, File::GetIoChunkSize() ) );
+      auto read = co_await ReadAsync( file, offset, pDest + offset, bytes );
+      if( !read.success || read.bytesTransferred != bytes )
+      {
+        result.resize( 0 );
+        co_return false;
+      }
+      offset += bytes;
+    }
+    co_return true;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // One read or write. Issued when awaited; the awaiting coroutine resumes
+  // through the Executor once the operation completes.
+
+  class Awaitable
+  {
+  public:
+
+    bool await_ready() const noexcept {
+      return ( bytes_ == 0 );
+    }
+
+    bool await_suspend( std::coroutine_handle<> );
+
+    Result await_resume() const noexcept {
+      return result_;
+    }
+
+  private:
+
+    friend class FileIoScheduler;
+    Awaitable( FileIoScheduler&, const File&, uint64_t offset, void*, uint32_t, bool isWrite );
+
+  private:
+
+    FileIoScheduler* scheduler_;
+    const File*      file_;
+    uint64_t         offset_;
+    void*            buffer_;
+    uint32_t         bytes_;
+    bool             isWrite_;
+    Result           result_;
+
+  }; // class Awaitable
+
+  uint32_t GetWorkerCount() const {
+    return static_cast<uint32_t>( workers_.size() );
+  }
+
+private:
+
+  struct Operation;
+  struct Port; // POSIX only
+
+  bool Submit( std::unique_ptr<Operation> );
+  void Issue( std::unique_ptr<Operation> );
+  void WorkerThread();
+  void Finish( std::unique_ptr<Operation>, bool success, uint32_t bytes );
+  void Resume( std::coroutine_handle<> );
+
+private:
+
+  void*                    port_; // HANDLE on Windows; Port* on POSIX
+  uint32_t                 maxInFlight_;
+  std::vector<std::thread> workers_;
+  Executor                 executor_;
+
+  std::mutex                             mutex_;
+  std::condition_variable                idle_;
+  std::deque<std::unique_ptr<Operation>> queued_;      // waiting for a slot
+  uint32_t                               inFlight_;    // issued to the OS
+  size_t                                 outstanding_; // queued + in flight
+
+}; // class FileIoScheduler
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileIoSchedulerCommon.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  FileIoScheduler coroutine support; portable
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileIoScheduler.h"
+
+using namespace PKIsensee;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Awaitable operations
+
+FileIoScheduler::Awaitable FileIoScheduler::ReadAsync( const File& file, uint64_t offset, 
+                                                       void* pBuffer, uint32_t bytes )
+{
+  return Awaitable( *this, file, offset, pBuffer, bytes, false );
+}
+
+FileIoScheduler::Awaitable FileIoScheduler::WriteAsync( File& file, uint64_t offset, 
+                                                        const void* pBuffer, uint32_t bytes )
+{
+  return Awaitable( *this, file, offset, const_cast<void*>( pBuffer ), // never written through
+                    bytes, true );
+}
+
+void FileIoScheduler::Resume( std::coroutine_handle<> handle )
+{
+  if( executor_ )
+    executor_( handle );
+  else
+    handle.resume();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Awaitable
+
+FileIoScheduler::Awaitable::Awaitable( FileIoScheduler& scheduler, const File& file, 
+                                       uint64_t offset, void* pBuffer, uint32_t bytes, 
+                                       bool isWrite ) :
+  scheduler_( &scheduler ),
+  file_( &file ),
+  offset_( offset ),
+  buffer_( pBuffer ),
+  bytes_( bytes ),
+  isWrite_( isWrite ),
+  result_{ true, 0u }
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Submit the operation; its completion stores the result and resumes the
+// coroutine. The completion may run before the submit call returns, and the
+// resumed coroutine may destroy this awaitable, so nothing here touches
+// members after a successful submit. A failed submit resumes immediately.
+
+bool FileIoScheduler::Awaitable::await_suspend( std::coroutine_handle<> handle )
+{
+  auto completion = [this, handle]( bool success, uint32_t bytesTransferred )
+  {
+    result_ = { success, bytesTransferred };
+    scheduler_->Resume( handle );
+  };
+
+  auto isSubmitted = isWrite_ ?
+    scheduler_->Write( const_cast<File&>( *file_ ), offset_, buffer_, bytes_, completion ) :
+    scheduler_->Read( *file_, offset_, buffer_, bytes_, completion );
+  if( !isSubmitted )
+    result_ = { false, 0u };
+  return isSubmitted;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,522 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileIoSchedulerPosix.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  *** POSIX implementation (io_uring on Linux; thread pool elsewhere) ***
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include "FileIoScheduler.h"
+#include "File.h"
+#include "Log.h"
+
+// POSIX headers
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define PK_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace PKIsensee;
+
+namespace { // anonymous namespace
+
+int ToFd( void* file )
+{
+  return static_cast<int>( reinterpret_cast<intptr_t>( file ) );
+}
+
+#if defined(PK_IO_URING)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Minimal io_uring ring driven by raw system calls, so there's no liburing
+// dependency. Submissions are serialized by sqMutex; one worker at a time
+// owns the completion queue and waits in the kernel while the others wait
+// on cqMutex.
+
+class Ring
+{
+public:
+
+  Ring() = default;
+  ~Ring()
+  {
+    if( sqes_ != nullptr )
+      ::munmap( sqes_, sqesLen_ );
+    if( cqRing_ != nullptr && cqRing_ != sqRing_ )
+      ::munmap( cqRing_, cqRingLen_ );
+    if( sqRing_ != nullptr )
+      ::munmap( sqRing_, sqRingLen_ );
+    if( fd_ >= 0 )
+      ::close( fd_ );
+  }
+
+  Ring( const Ring& ) = delete;
+  Ring& operator=( const Ring& ) = delete;
+  Ring( Ring&& ) = delete;
+  Ring& operator=( Ring&& ) = delete;
+
+  // Returns false if the kernel doesn't support io_uring, or it's disabled
+  bool Init( uint32_t entries )
+  {
+    io_uring_params params = {};
+    fd_ = static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params ) );
+    if( fd_ < 0 )
+      return false;
+
+    sqRingLen_ = params.sq_off.array + params.sq_entries * sizeof( uint32_t );
+    cqRingLen_ = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+    auto isSingleMap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if( isSingleMap )
+      sqRingLen_ = cqRingLen_ = std::max( sqRingLen_, cqRingLen_ );
+
+    sqRing_ = Map( sqRingLen_, IORING_OFF_SQ_RING );
+    if( sqRing_ == nullptr )
+      return false;
+    cqRing_ = isSingleMap ? sqRing_ : Map( cqRingLen_, IORING_OFF_CQ_RING );
+    if( cqRing_ == nullptr )
+      return false;
+    sqesLen_ = params.sq_entries * sizeof( io_uring_sqe );
+    sqes_ = static_cast<io_uring_sqe*>( Map( sqesLen_, IORING_OFF_SQES ) );
+    if( sqes_ == nullptr )
+      return false;
+
+    auto sq = static_cast<char*>( sqRing_ );
+    sqHead_  = reinterpret_cast<uint32_t*>( sq + params.sq_off.head );
+    sqTail_  = reinterpret_cast<uint32_t*>( sq + params.sq_off.tail );
+    sqMask_  = *reinterpret_cast<uint32_t*>( sq + params.sq_off.ring_mask );
+    sqArray_ = reinterpret_cast<uint32_t*>( sq + params.sq_off.array );
+    sqEntries_ = params.sq_entries;
+
+    auto cq = static_cast<char*>( cqRing_ );
+    cqHead_ = reinterpret_cast<uint32_t*>( cq + params.cq_off.head );
+    cqTail_ = reinterpret_cast<uint32_t*>( cq + params.cq_off.tail );
+    cqMask_ = *reinterpret_cast<uint32_t*>( cq + params.cq_off.ring_mask );
+    cqes_   = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+    return true;
+  }
+
+  // Queue and submit one operation. userData is returned with its completion.
+  // Returns a negative errno if the kernel refused the submission.
+  int Submit( uint8_t opcode, int fd, uint64_t offset, void* pBuffer, uint32_t bytes,
+              uint64_t userData )
+  {
+    std::lock_guard lock( sqMutex_ );
+    auto tail = *sqTail_;
+    auto head = std::atomic_ref( *sqHead_ ).load( std::memory_order_acquire );
+    if( tail - head >= sqEntries_ )
+      return -EBUSY;
+
+    auto index = tail & sqMask_;
+    auto& sqe = sqes_[ index ];
+    sqe = {};
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uint64_t>( pBuffer );
+    sqe.len = bytes;
+    sqe.user_data = userData;
+    sqArray_[ index ] = index;
+    std::atomic_ref( *sqTail_ ).store( tail + 1, std::memory_order_release );
+
+    for( ;; )
+    {
+      auto submitted = ::syscall( __NR_io_uring_enter, fd_, 1u, 0u, 0u, nullptr, 0u );
+      if( submitted >= 0 )
+        return 0;
+      if( errno != EINTR && errno != EAGAIN )
+        break;
+    }
+
+    // Take the entry back; nobody else submits while we hold the lock
+    auto error = -errno;
+    std::atomic_ref( *sqTail_ ).store( tail, std::memory_order_release );
+    return error;
+  }
+
+  // Block until a completion is available and consume it
+  void Reap( uint64_t& userData, int32_t& result )
+  {
+    std::lock_guard lock( cqMutex_ );
+    for( ;; )
+    {
+      auto head = *cqHead_;
+      if( head != std::atomic_ref( *cqTail_ ).load( std::memory_order_acquire ) )
+      {
+        const auto& cqe = cqes_[ head & cqMask_ ];
+        userData = cqe.user_data;
+        result = cqe.res;
+        std::atomic_ref( *cqHead_ ).store( head + 1, std::memory_order_release );
+        return;
+      }
+      ::syscall( __NR_io_uring_enter, fd_, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0u );
+    }
+  }
+
+private:
+
+  void* Map( size_t length, off_t offset ) const
+  {
+    auto p = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, 
+                     fd_, offset );
+    return ( p == MAP_FAILED ) ? nullptr : p;
+  }
+
+private:
+
+  int           fd_ = -1;
+  void*         sqRing_ = nullptr;
+  void*         cqRing_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t        sqRingLen_ = 0u;
+  size_t        cqRingLen_ = 0u;
+  size_t        sqesLen_ = 0u;
+
+  uint32_t*     sqHead_ = nullptr;
+  uint32_t*     sqTail_ = nullptr;
+  uint32_t*     sqArray_ = nullptr;
+  uint32_t      sqMask_ = 0u;
+  uint32_t      sqEntries_ = 0u;
+  uint32_t*     cqHead_ = nullptr;
+  uint32_t*     cqTail_ = nullptr;
+  uint32_t      cqMask_ = 0u;
+  io_uring_cqe* cqes_ = nullptr;
+
+  std::mutex    sqMutex_;
+  std::mutex    cqMutex_;
+};
+
+#endif // PK_IO_URING
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// One read or write. Owned by the ring or the ready queue while issued.
+
+struct FileIoScheduler::Operation
+{
+  int        fd;
+  uint64_t   offset;
+  void*      buffer;
+  uint32_t   bytes;
+  bool       isWrite;
+  bool       isIssueFailed; // result holds the submission error
+  int32_t    result; // bytes transferred, or negative errno
+  Completion completion;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The completion "port": an io_uring ring when the kernel has one, otherwise
+// a queue of operations that the workers perform with pread/pwrite
+
+struct FileIoScheduler::Port
+{
+#if defined(PK_IO_URING)
+  std::unique_ptr<Ring> ring;
+#endif
+  std::mutex              mutex;
+  std::condition_variable ready;
+  std::deque<Operation*> queue; // nullptr tells a worker to exit
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctor
+
+FileIoScheduler::FileIoScheduler( uint32_t workerCount, uint32_t maxInFlight ) :
+  port_( nullptr ),
+  maxInFlight_( std::max( maxInFlight, 1u ) ),
+  workers_(),
+  executor_(),
+  mutex_(),
+  idle_(),
+  queued_(),
+  inFlight_( 0u ),
+  outstanding_( 0u )
+{
+  if( workerCount == 0 )
+    workerCount = std::max( std::thread::hardware_concurrency(), 1u );
+
+  auto port = std::make_unique<Port>();
+#if defined(PK_IO_URING)
+  // Room for every in-flight operation plus one exit request per worker
+  auto ring = std::make_unique<Ring>();
+  if( ring->Init( std::bit_ceil( maxInFlight_ + workerCount ) ) )
+    port->ring = std::move( ring );
+#endif
+  port_ = port.release();
+
+  workers_.reserve( workerCount );
+  for( uint32_t i = 0; i < workerCount; ++i )
+    workers_.emplace_back( &FileIoScheduler::WorkerThread, this );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor. Completes all outstanding operations before stopping the workers.
+
+FileIoScheduler::~FileIoScheduler()
+{
+  WaitIdle();
+
+  auto port = static_cast<Port*>( port_ );
+  for( size_t i = 0; i < workers_.size(); ++i )
+  {
+#if defined(PK_IO_URING)
+    // A NOP without an operation tells a worker to exit
+    if( port->ring )
+    {
+      [[maybe_unused]] auto result = port->ring->Submit( IORING_OP_NOP, -1, 0, nullptr, 0, 0 );
+      assert( result == 0 );
+      continue;
+    }
+#endif
+    std::lock_guard lock( port->mutex );
+    port->queue.push_back( nullptr );
+    port->ready.notify_one();
+  }
+  for( auto& worker : workers_ )
+    worker.join();
+
+  delete port;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Nothing to bind on POSIX; kept so callers are portable
+
+bool FileIoScheduler::Attach( const File& file )
+{
+  assert( file.IsOpen() );
+  assert( file.GetFlags() & FileFlags::Async );
+  (void)file;
+  return( port_ != nullptr );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Queue a read at the given offset. The buffer must remain valid until the
+// completion runs. Returns false only if the scheduler is unusable; I/O errors
+// are reported to the completion.
+
+bool FileIoScheduler::Read( const File& file, uint64_t offset, void* pBuffer, 
+                            uint32_t bytes, Completion completion )
+{
+  assert( file.IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  auto op = std::make_unique<Operation>();
+  op->fd = ToFd( file.file_ );
+  op->offset = offset;
+  op->buffer = pBuffer;
+  op->bytes = bytes;
+  op->isWrite = false;
+  op->isIssueFailed = false;
+  op->result = 0;
+  op->completion = std::move( completion );
+  return Submit( std::move( op ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Queue a write at the given offset. The buffer must remain valid until the
+// completion runs.
+
+bool FileIoScheduler::Write( File& file, uint64_t offset, const void* pBuffer, 
+                             uint32_t bytes, Completion completion )
+{
+  assert( file.IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  auto op = std::make_unique<Operation>();
+  op->fd = ToFd( file.file_ );
+  op->offset = offset;
+  op->buffer = const_cast<void*>( pBuffer ); // never written through
+  op->bytes = bytes;
+  op->isWrite = true;
+  op->isIssueFailed = false;
+  op->result = 0;
+  op->completion = std::move( completion );
+  return Submit( std::move( op ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Block until every submitted operation has completed and its completion has
+// returned
+
+void FileIoScheduler::WaitIdle()
+{
+  std::unique_lock lock( mutex_ );
+  idle_.wait( lock, [this] { return outstanding_ == 0; } );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue now if below the in-flight limit, otherwise queue
+
+bool FileIoScheduler::Submit( std::unique_ptr<Operation> op )
+{
+  if( port_ == nullptr )
+    return false;
+  {
+    std::lock_guard lock( mutex_ );
+    ++outstanding_;
+    if( inFlight_ >= maxInFlight_ )
+    {
+      queued_.push_back( std::move( op ) );
+      return true;
+    }
+    ++inFlight_;
+  }
+  Issue( std::move( op ) );
+  return true;
+}
+
+void FileIoScheduler::Issue( std::unique_ptr<Operation> op )
+{
+  auto port = static_cast<Port*>( port_ );
+#if defined(PK_IO_URING)
+  if( port->ring )
+  {
+    // Ownership passes to the ring
+    auto pOp = op.release();
+    auto result = port->ring->Submit( pOp->isWrite ? IORING_OP_WRITE : IORING_OP_READ,
+                                      pOp->fd, pOp->offset, pOp->buffer, pOp->bytes,
+                                      reinterpret_cast<uint64_t>( pOp ) );
+    if( result == 0 )
+      return;
+
+    // The kernel refused the submission, so nothing will be reaped for it.
+    // Queue a NOP carrying the operation so a worker reports the failure like
+    // any other completion.
+    PKLOG_WARN( "io_uring_enter failed with error %d\n", -result );
+    pOp->isIssueFailed = true;
+    pOp->result = result;
+    if( port->ring->Submit( IORING_OP_NOP, -1, 0, nullptr, 0, 
+                            reinterpret_cast<uint64_t>( pOp ) ) == 0 )
+      return;
+
+    // The ring can't take even a NOP, so it's unusable; report from here
+    op.reset( pOp );
+    Finish( std::move( op ), false, 0u );
+    return;
+  }
+#endif
+
+  std::lock_guard lock( port->mutex );
+  port->queue.push_back( op.release() );
+  port->ready.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dispatch completions until told to exit
+
+void FileIoScheduler::WorkerThread()
+{
+  auto port = static_cast<Port*>( port_ );
+  for( ;; )
+  {
+    std::unique_ptr<Operation> op;
+#if defined(PK_IO_URING)
+    if( port->ring )
+    {
+      uint64_t userData = 0u;
+      int32_t result = 0;
+      port->ring->Reap( userData, result );
+      if( userData == 0 )
+        return;
+      op.reset( reinterpret_cast<Operation*>( userData ) );
+      if( !op->isIssueFailed )
+        op->result = result;
+    }
+    else
+#endif
+    {
+      {
+        std::unique_lock lock( port->mutex );
+        port->ready.wait( lock, [port] { return !port->queue.empty(); } );
+        op.reset( port->queue.front() );
+        port->queue.pop_front();
+      }
+      if( !op )
+        return;
+
+      // Perform the operation here; ReadAt and friends need a File
+      for( ;; )
+      {
+        auto result = op->isWrite ?
+          ::pwrite( op->fd, op->buffer, op->bytes, static_cast<off_t>( op->offset ) ) :
+          ::pread( op->fd, op->buffer, op->bytes, static_cast<off_t>( op->offset ) );
+        if( result < 0 && errno == EINTR )
+          continue;
+        op->result = ( result < 0 ) ? -errno : static_cast<int32_t>( result );
+        break;
+      }
+    }
+
+    // Reading at or past the end of the file isn't a failure; it returns zero
+    bool succeeded = ( op->result >= 0 );
+    auto bytes = succeeded ? static_cast<uint32_t>( op->result ) : 0u;
+    Finish( std::move( op ), succeeded, bytes );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run the completion and hand the freed slot to the next queued operation
+
+void FileIoScheduler::Finish( std::unique_ptr<Operation> op, bool succeeded, uint32_t bytes )
+{
+  if( op->completion )
+    op->completion( succeeded, bytes );
+  op.reset();
+
+  std::unique_ptr<Operation> next;
+  {
+    std::lock_guard lock( mutex_ );
+    if( !queued_.empty() )
+    {
+      next = std::move( queued_.front() );
+      queued_.pop_front();
+    }
+    else
+    {
+      --inFlight_;
+    }
+    if( --outstanding_ == 0 )
+      idle_.notify_all();
+  }
+  if( next )
+    Issue( std::move( next ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // !_WIN32
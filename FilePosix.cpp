@@ -0,0 +1,1124 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FilePosix.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  *** POSIX implementation (Linux, macOS) ***
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <limits>
+#include <new>
+#include <string_view>
+#include "File.h"
+#include "FileStats.h"
+#include "Log.h"
+
+// POSIX headers
+#include <aio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+constexpr int kInvalidFd = -1;
+
+// File stores the descriptor in its void* handle; -1 matches the bit pattern
+// of INVALID_HANDLE_VALUE
+int ToFd( void* file )
+{
+  return static_cast<int>( reinterpret_cast<intptr_t>( file ) );
+}
+
+void* FromFd( int fd )
+{
+  return reinterpret_cast<void*>( static_cast<intptr_t>( fd ) );
+}
+
+struct OpenParams
+{
+  int flags = O_CLOEXEC;
+
+  OpenParams( int howToOpen, FileFlags fileFlags )
+  {
+    // Can't specify both sequential and random
+    assert( !( ( fileFlags & FileFlags::SequentialScan ) && ( fileFlags & FileFlags::RandomAccess ) ) );
+
+    // Need to open for either reading and/or writing
+    assert( ( fileFlags & FileFlags::Read ) || ( fileFlags & FileFlags::Write ) );
+
+    // Sharing flags have no POSIX equivalent; locks are advisory.
+    // Async needs no open flag; any descriptor accepts positional and aio calls.
+    if( ( fileFlags & FileFlags::Read ) && ( fileFlags & FileFlags::Write ) )
+      flags |= O_RDWR;
+    else if( fileFlags & FileFlags::Write )
+      flags |= O_WRONLY;
+    else
+      flags |= O_RDONLY;
+    flags |= howToOpen;
+    if( ( fileFlags & FileFlags::Append ) && ( fileFlags & FileFlags::Write ) )
+    {
+      flags |= O_APPEND;
+      flags &= ~O_TRUNC;
+    }
+
+#if defined(O_DIRECT)
+    if( fileFlags & FileFlags::Unbuffered )   flags |= O_DIRECT;
+#endif
+    if( fileFlags & FileFlags::WriteThrough ) flags |= O_DSYNC;
+  }
+};
+
+int OpenFd( const fs::path& path, int flags )
+{
+  int fd = kInvalidFd;
+  do
+  {
+    fd = ::open( path.c_str(), flags, 0666 );
+  } while( fd == kInvalidFd && errno == EINTR );
+
+#if defined(O_DIRECT)
+  // Some file systems, e.g. tmpfs, refuse O_DIRECT; fall back to cached I/O
+  if( fd == kInvalidFd && errno == EINVAL && ( flags & O_DIRECT ) )
+    return OpenFd( path, flags & ~O_DIRECT );
+#endif
+  return fd;
+}
+
+// Access pattern and caching hints that POSIX applies after opening
+void ApplyHints( int fd, FileFlags flags )
+{
+#if defined(POSIX_FADV_SEQUENTIAL)
+  if( flags & FileFlags::SequentialScan ) ::posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+  if( flags & FileFlags::RandomAccess )   ::posix_fadvise( fd, 0, 0, POSIX_FADV_RANDOM );
+#elif defined(F_RDAHEAD)
+  if( flags & FileFlags::RandomAccess )   ::fcntl( fd, F_RDAHEAD, 0 );
+#endif
+#if defined(F_NOCACHE)
+  if( flags & FileFlags::Unbuffered )     ::fcntl( fd, F_NOCACHE, 1 );
+#endif
+  (void)fd;
+  (void)flags;
+}
+
+File::Time ToStdTime( int64_t seconds, int64_t nanoseconds )
+{
+  // Same units and epoch as fs::file_time_type, matching the Windows version
+  using namespace std::chrono;
+  system_clock::time_point sysTime{ duration_cast<system_clock::duration>( 
+                                    std::chrono::seconds( seconds ) + 
+                                    std::chrono::nanoseconds( nanoseconds ) ) };
+  auto fileTime = file_clock::from_sys( sysTime );
+  return duration_cast<fs::file_time_type::duration>( fileTime.time_since_epoch() ).count();
+}
+
+// Subset of stat results that File reports
+struct NativeStat
+{
+  uint64_t    length = 0u;
+  File::Times times = {};
+  uint32_t    mode = 0u;
+  uint64_t    device = 0u;
+  uint64_t    inode = 0u;
+};
+
+// Stat relative to a directory descriptor, or the descriptor itself when name
+// is empty. Uses statx on Linux for the creation (birth) time; elsewhere
+// falls back to the status change time where no birth time exists.
+
+bool StatAt( int dirFd, const char* name, NativeStat& result )
+{
+  auto atFlags = AT_SYMLINK_NOFOLLOW;
+#if defined(STATX_BTIME)
+  if( *name == '\0' )
+    atFlags |= AT_EMPTY_PATH;
+  struct statx stx = {};
+  if( ::statx( dirFd, name, atFlags, STATX_BASIC_STATS | STATX_BTIME, &stx ) != 0 )
+    return false;
+  result.mode = stx.stx_mode;
+  result.device = ::makedev( stx.stx_dev_major, stx.stx_dev_minor );
+  result.inode = stx.stx_ino;
+  result.length = S_ISDIR( stx.stx_mode ) ? 0u : stx.stx_size;
+  auto created = ( stx.stx_mask & STATX_BTIME ) ? stx.stx_btime : stx.stx_ctime;
+  result.times.creationTime   = ToStdTime( created.tv_sec, created.tv_nsec );
+  result.times.lastAccessTime = ToStdTime( stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec );
+  result.times.lastWriteTime  = ToStdTime( stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec );
+#else
+  struct stat st = {};
+  auto success = ( *name == '\0' ) ? ::fstat( dirFd, &st ) : ::fstatat( dirFd, name, &st, atFlags );
+  if( success != 0 )
+    return false;
+  result.mode = st.st_mode;
+  result.device = static_cast<uint64_t>( st.st_dev );
+  result.inode = static_cast<uint64_t>( st.st_ino );
+  result.length = S_ISDIR( st.st_mode ) ? 0u : static_cast<uint64_t>( st.st_size );
+#if defined(__APPLE__)
+  result.times.creationTime   = ToStdTime( st.st_birthtimespec.tv_sec, st.st_birthtimespec.tv_nsec );
+  result.times.lastAccessTime = ToStdTime( st.st_atimespec.tv_sec, st.st_atimespec.tv_nsec );
+  result.times.lastWriteTime  = ToStdTime( st.st_mtimespec.tv_sec, st.st_mtimespec.tv_nsec );
+#else
+  result.times.creationTime   = ToStdTime( st.st_ctim.tv_sec, st.st_ctim.tv_nsec );
+  result.times.lastAccessTime = ToStdTime( st.st_atim.tv_sec, st.st_atim.tv_nsec );
+  result.times.lastWriteTime  = ToStdTime( st.st_mtim.tv_sec, st.st_mtim.tv_nsec );
+#endif
+#endif
+  return true;
+}
+
+bool StatPath( const fs::path& path, NativeStat& result )
+{
+  return StatAt( AT_FDCWD, path.c_str(), result );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// read/pread and write/pwrite may transfer fewer bytes than asked, e.g. when
+// interrupted. ReadFile and WriteFile don't, so loop until done, EOF or error.
+// A negative offset uses the file position.
+
+bool ReadFully( int fd, void* pBuffer, size_t bytes, int64_t offset, size_t& bytesRead )
+{
+  auto pDest = static_cast<char*>( pBuffer );
+  bytesRead = 0u;
+  while( bytesRead < bytes )
+  {
+    auto result = ( offset < 0 ) ? 
+      ::read( fd, pDest + bytesRead, bytes - bytesRead ) :
+      ::pread( fd, pDest + bytesRead, bytes - bytesRead, static_cast<off_t>( offset + int64_t( bytesRead ) ) );
+    if( result < 0 )
+    {
+      if( errno == EINTR )
+        continue;
+      return false;
+    }
+    if( result == 0 )
+      break;
+    bytesRead += static_cast<size_t>( result );
+  }
+  return true;
+}
+
+bool WriteFully( int fd, const void* pBuffer, size_t bytes, int64_t offset )
+{
+  auto pSrc = static_cast<const char*>( pBuffer );
+  size_t bytesWritten = 0u;
+  while( bytesWritten < bytes )
+  {
+    auto result = ( offset < 0 ) ?
+      ::write( fd, pSrc + bytesWritten, bytes - bytesWritten ) :
+      ::pwrite( fd, pSrc + bytesWritten, bytes - bytesWritten, static_cast<off_t>( offset + int64_t( bytesWritten ) ) );
+    if( result < 0 )
+    {
+      if( errno == EINTR )
+        continue;
+      return false;
+    }
+    bytesWritten += static_cast<size_t>( result );
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Transfer buffers that cover a contiguous range of the file with as few
+// preadv/pwritev calls as possible, resuming after short transfers.
+
+template <class Vec>
+bool TransferRun( int fd, std::span<const Vec> run, bool isWrite )
+{
+  std::vector<iovec> iov;
+  iov.reserve( run.size() );
+  for( const auto& buffer : run )
+  {
+    assert( buffer.bytes > 0 );
+    iov.push_back( { const_cast<void*>( static_cast<const void*>( buffer.data ) ), buffer.bytes } );
+  }
+
+  auto offset = static_cast<off_t>( run.front().offset );
+  size_t first = 0u;
+  while( first < iov.size() )
+  {
+    auto count = static_cast<int>( std::min<size_t>( iov.size() - first, IOV_MAX ) );
+    auto result = isWrite ? ::pwritev( fd, &iov[ first ], count, offset ) :
+                            ::preadv( fd, &iov[ first ], count, offset );
+    if( result < 0 && errno == EINTR )
+      continue;
+    if( result <= 0 ) // error, or end of file before every buffer was filled
+      return false;
+    offset += result;
+
+    // Skip buffers that are done and trim one that's partly done
+    auto remaining = static_cast<size_t>( result );
+    while( remaining > 0 )
+    {
+      auto& vec = iov[ first ];
+      if( remaining >= vec.iov_len )
+      {
+        remaining -= vec.iov_len;
+        ++first;
+      }
+      else
+      {
+        vec.iov_base = static_cast<char*>( vec.iov_base ) + remaining;
+        vec.iov_len -= remaining;
+        remaining = 0;
+      }
+    }
+  }
+  return true;
+}
+
+template <class Vec>
+uint64_t TotalBytes( std::span<const Vec> buffers )
+{
+  uint64_t total = 0u;
+  for( const auto& buffer : buffers )
+    total += buffer.bytes;
+  return total;
+}
+
+// Split the buffers into runs that are contiguous in the file
+
+template <class Vec>
+bool TransferVectored( int fd, std::span<const Vec> buffers, bool isWrite )
+{
+  size_t begin = 0u;
+  for( size_t i = 1; i <= buffers.size(); ++i )
+  {
+    if( i < buffers.size() && buffers[ i ].offset == buffers[ i - 1 ].offset + buffers[ i - 1 ].bytes )
+      continue;
+    if( !TransferRun( fd, buffers.subspan( begin, i - begin ), isWrite ) )
+      return false;
+    begin = i;
+  }
+  return true;
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctors
+
+File::File() :
+  path_(),
+  file_( FromFd( kInvalidFd ) ),
+  flags_(),
+  stats_( nullptr )
+{
+}
+
+File::File( const fs::path& path ) :
+  path_( path ),
+  file_( FromFd( kInvalidFd ) ),
+  flags_(),
+  stats_( nullptr )
+{
+  path_.make_preferred();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Move; the source is left closed
+
+File::File( File&& rhs ) noexcept :
+  path_( std::move( rhs.path_ ) ),
+  file_( std::exchange( rhs.file_, FromFd( kInvalidFd ) ) ),
+  flags_( std::exchange( rhs.flags_, FileFlags() ) ),
+  stats_( std::exchange( rhs.stats_, nullptr ) )
+{
+}
+
+File& File::operator=( File&& rhs ) noexcept
+{
+  if( this != &rhs )
+  {
+    Close();
+    path_ = std::move( rhs.path_ );
+    file_ = std::exchange( rhs.file_, FromFd( kInvalidFd ) );
+    flags_ = std::exchange( rhs.flags_, FileFlags() );
+    stats_ = std::exchange( rhs.stats_, nullptr );
+  }
+  return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Dtor
+
+File::~File()
+{
+  if( IsOpen() )
+    ::close( ToFd( file_ ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Create the file or directory, including any intermediate directories.
+// Closes any currently open file or folder.
+
+bool File::Create( FileFlags flags )
+{
+  OpenParams op( O_CREAT | O_TRUNC, flags );
+  assert( path_.has_filename() || path_.has_parent_path() );
+  Close();
+  if( path_.has_parent_path() )
+  {
+    fs::create_directories( path_.parent_path() );
+
+    // Directories can only be opened for reading
+    if( !path_.has_filename() )
+      op.flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  }
+
+  FileStats::Timer timer( stats_, FileOp::Create );
+  auto fd = OpenFd( path_, op.flags );
+  file_ = FromFd( fd );
+  timer.Done( path_, 0, fd != kInvalidFd );
+  if( fd == kInvalidFd )
+  {
+    PKLOG_WARN( "open failed to create file %s with error %d\n", path_.c_str(), errno );
+    return false;
+  }
+  flags_ = flags;
+  ApplyHints( fd, flags );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Open the file or directory. Closes any currently open file.
+
+bool File::Open( FileFlags flags )
+{
+  OpenParams op( 0, flags );
+  assert( path_.has_filename() || path_.has_parent_path() );
+
+  // Directories can only be opened for reading
+  if( !path_.has_filename() )
+    op.flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+
+  Close();
+  FileStats::Timer timer( stats_, FileOp::Open );
+  auto fd = OpenFd( path_, op.flags );
+  file_ = FromFd( fd );
+  timer.Done( path_, 0, fd != kInvalidFd );
+  if( fd == kInvalidFd )
+  {
+    PKLOG_WARN( "open failed to open file %s with error %d\n", path_.c_str(), errno );
+    return false;
+  }
+  flags_ = flags;
+  ApplyHints( fd, flags );
+  return true;
+}
+
+void File::Close()
+{
+  if( IsOpen() )
+  {
+    ::close( ToFd( file_ ) );
+    file_ = FromFd( kInvalidFd );
+    flags_ = FileFlags();
+  }
+}
+
+bool File::IsOpen() const
+{
+  return( ToFd( file_ ) != kInvalidFd );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Size of file in bytes; zero for directories, as on Windows
+
+uint64_t File::GetLength() const
+{
+  NativeStat st;
+  if( !IsOpen() )
+  {
+    StatPath( path_, st );
+    return st.length;
+  }
+  [[maybe_unused]] auto success = StatAt( ToFd( file_ ), "", st );
+  assert( success );
+  return st.length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Extract time that file/dir was created, accessed, modified
+
+bool File::GetFileTimes( File::Times& fileTimes ) const
+{
+  NativeStat st;
+  auto success = IsOpen() ? StatAt( ToFd( file_ ), "", st ) : StatPath( path_, st );
+  assert( success );
+  if( !success )
+    return false;
+  fileTimes = st.times;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Length, times, mode and IDs in one call. Unlike Windows, a closed file
+// reports IDs too. Returns false if the file doesn't exist.
+
+bool File::GetInfo( File::Info& info ) const
+{
+  NativeStat st;
+  auto success = IsOpen() ? StatAt( ToFd( file_ ), "", st ) : StatPath( path_, st );
+  if( !success )
+    return false;
+  info.length = st.length;
+  info.times = st.times;
+  info.attributes = st.mode;
+  info.volumeId = st.device;
+  info.fileId = st.inode;
+  info.isDirectory = S_ISDIR( st.mode );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Invoke the callback with the length, times and attributes of every entry in
+// the directory, excluding "." and "..". Not recursive. POSIX has no batched
+// metadata listing, so each entry costs one stat relative to the open
+// directory. attributes holds st_mode. Returns false if the directory can't
+// be read.
+
+bool File::EnumerateDirectory( const fs::path& dir, const DirCallback& callback )
+{
+  auto pDir = ::opendir( dir.c_str() );
+  if( pDir == nullptr )
+  {
+    PKLOG_WARN( "opendir failed to enumerate %s with error %d\n", dir.c_str(), errno );
+    return false;
+  }
+
+  auto dirFd = ::dirfd( pDir );
+  DirEntry entry;
+  entry.path = dir;
+  entry.path /= "*";
+  auto isDone = false;
+  while( !isDone )
+  {
+    auto pEntry = ::readdir( pDir );
+    if( pEntry == nullptr )
+      break;
+
+    std::string_view name( pEntry->d_name );
+    if( name == "." || name == ".." )
+      continue;
+
+    // Entries removed since readdir are skipped
+    NativeStat st;
+    if( !StatAt( dirFd, pEntry->d_name, st ) )
+      continue;
+
+    entry.path.replace_filename( name );
+    entry.length = st.length;
+    entry.times = st.times;
+    entry.attributes = st.mode;
+    entry.isDirectory = S_ISDIR( st.mode );
+    entry.isLink = S_ISLNK( st.mode );
+    isDone = !callback( entry );
+  }
+
+  ::closedir( pDir );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Set the next position for reading or writing. Position is always from the
+// beginning of the file.
+
+bool File::SetPos( uint64_t pos ) const
+{
+  assert( IsOpen() );
+  return( ::lseek( ToFd( file_ ), static_cast<off_t>( pos ), SEEK_SET ) != -1 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read a buffer from the current file position; returns bytesRead
+
+bool File::Read( void* pBuffer, uint32_t bytes, uint32_t& bytesRead ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  FileStats::Timer timer( stats_, FileOp::Read );
+  size_t br = 0u;
+  auto success = ReadFully( ToFd( file_ ), pBuffer, bytes, -1, br );
+  bytesRead = static_cast<uint32_t>( br );
+  timer.Done( path_, br, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write a buffer to the current file position. Buffers larger than the I/O
+// chunk size are written with multiple calls.
+
+bool File::Write( const void* pBuffer, uint64_t bytes )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr || bytes == 0 );
+
+  FileStats::Timer timer( stats_, FileOp::Write );
+  auto chunkSize = GetIoChunkSize();
+  auto pSrc = static_cast<const uint8_t*>( pBuffer );
+  uint64_t total = 0u;
+  while( bytes > 0 )
+  {
+    auto chunk = static_cast<size_t>( std::min<uint64_t>( bytes, chunkSize ) );
+    if( !WriteFully( ToFd( file_ ), pSrc, chunk, -1 ) )
+    {
+      timer.Done( path_, total, false );
+      return false;
+    }
+    total += chunk;
+    pSrc += chunk;
+    bytes -= chunk;
+  }
+  timer.Done( path_, total, true );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Allocate storage for at least the given number of bytes without changing
+// the file length
+
+bool File::Reserve( uint64_t bytes )
+{
+  assert( IsOpen() );
+#if defined(__linux__)
+  return( ::fallocate( ToFd( file_ ), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>( bytes ) ) == 0 );
+#elif defined(F_PREALLOCATE)
+  // Allocation is relative to the physical end of file
+  auto length = GetLength();
+  if( bytes <= length )
+    return true;
+  fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, 
+                     static_cast<off_t>( bytes - length ), 0 };
+  if( ::fcntl( ToFd( file_ ), F_PREALLOCATE, &store ) == 0 )
+    return true;
+  store.fst_flags = F_ALLOCATEALL;
+  return( ::fcntl( ToFd( file_ ), F_PREALLOCATE, &store ) == 0 );
+#else
+  (void)bytes;
+  return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Truncate or extend the file. Extended bytes read as zero.
+
+bool File::SetLength( uint64_t bytes )
+{
+  assert( IsOpen() );
+  return( ::ftruncate( ToFd( file_ ), static_cast<off_t>( bytes ) ) == 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// POSIX files are sparse whenever the file system supports it; nothing to do
+
+bool File::SetSparse( bool )
+{
+  assert( IsOpen() );
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Zero a range of the file, deallocating it where the file system allows.
+// Without hole punching the range is overwritten with zeros.
+
+bool File::PunchHole( uint64_t offset, uint64_t length )
+{
+  assert( IsOpen() );
+  auto fd = ToFd( file_ );
+#if defined(FALLOC_FL_PUNCH_HOLE)
+  if( ::fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 
+                   static_cast<off_t>( offset ), static_cast<off_t>( length ) ) == 0 )
+    return true;
+#endif
+
+  // Like FSCTL_SET_ZERO_DATA, don't extend the file
+  auto fileLen = GetLength();
+  if( offset >= fileLen )
+    return true;
+  length = std::min( length, fileLen - offset );
+
+  static constexpr std::byte kZeros[ 64 * 1024 ] = {};
+  while( length > 0 )
+  {
+    auto chunk = static_cast<size_t>( std::min<uint64_t>( length, sizeof( kZeros ) ) );
+    if( !WriteFully( fd, kZeros, chunk, static_cast<int64_t>( offset ) ) )
+      return false;
+    offset += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read a buffer from the given file offset; returns bytesRead, which is zero
+// at or beyond the end of the file. Safe to call from multiple threads; the
+// file position is not changed.
+
+bool File::ReadAt( uint64_t offset, void* pBuffer, uint32_t bytes, uint32_t& bytesRead ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+
+  FileStats::Timer timer( stats_, FileOp::Read );
+  size_t br = 0u;
+  auto success = ReadFully( ToFd( file_ ), pBuffer, bytes, static_cast<int64_t>( offset ), br );
+  bytesRead = static_cast<uint32_t>( br );
+  timer.Done( path_, br, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write a buffer at the given file offset, extending the file if necessary
+
+bool File::WriteAt( uint64_t offset, const void* pBuffer, uint32_t bytes )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+  FileStats::Timer timer( stats_, FileOp::Write );
+  auto success = WriteFully( ToFd( file_ ), pBuffer, bytes, static_cast<int64_t>( offset ) );
+  timer.Done( path_, success ? bytes : 0u, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read many buffers. Buffers that are contiguous in the file are read with one
+// preadv, whether or not the file was opened for async I/O.
+
+bool File::ReadV( std::span<const IoVec> buffers ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  if( buffers.empty() )
+    return true;
+  FileStats::Timer timer( stats_, FileOp::Read );
+  auto success = TransferVectored( ToFd( file_ ), buffers, false );
+  if( timer.IsActive() )
+    timer.Done( path_, success ? TotalBytes( buffers ) : 0u, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Write many buffers; the mirror of ReadV, using pwritev
+
+bool File::WriteV( std::span<const ConstIoVec> buffers )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  if( buffers.empty() )
+    return true;
+  FileStats::Timer timer( stats_, FileOp::Write );
+  auto success = TransferVectored( ToFd( file_ ), buffers, true );
+  if( timer.IsActive() )
+    timer.Done( path_, success ? TotalBytes( buffers ) : 0u, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Start read-ahead of the range into the page cache without waiting for it
+
+bool File::Prefetch( uint64_t offset, uint64_t length ) const
+{
+  assert( IsOpen() );
+  auto fileLen = GetLength();
+  if( offset >= fileLen )
+    return true;
+  length = std::min( length, fileLen - offset );
+
+#if defined(POSIX_FADV_WILLNEED)
+  auto result = ::posix_fadvise( ToFd( file_ ), static_cast<off_t>( offset ), 
+                                 static_cast<off_t>( length ), POSIX_FADV_WILLNEED );
+  if( result == 0 )
+    return true;
+  PKLOG_WARN( "posix_fadvise failed to prefetch %s with error %d\n", path_.c_str(), result );
+  return false;
+#elif defined(F_RDADVISE)
+  radvisory advice = { static_cast<off_t>( offset ), 
+                       static_cast<int>( std::min<uint64_t>( length, INT_MAX ) ) };
+  if( ::fcntl( ToFd( file_ ), F_RDADVISE, &advice ) != -1 )
+    return true;
+  PKLOG_WARN( "fcntl failed to prefetch %s with error %d\n", path_.c_str(), errno );
+  return false;
+#else
+  return true;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue an asynchronous read at the given file offset using POSIX AIO. Reads
+// at or beyond the end of the file complete successfully with zero bytes.
+
+bool File::ReadAsync( uint64_t offset, void* pBuffer, uint32_t bytes, 
+                      AsyncRequest& request ) const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( flags_ & FileFlags::Async );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+  assert( !request.IsPending() );
+
+  request.Begin( *this, offset, bytes, false );
+  auto pControl = reinterpret_cast<aiocb*>( request.native_ );
+  pControl->aio_buf = pBuffer;
+  if( ::aio_read( pControl ) == 0 )
+    return true;
+
+  request.Complete( false, 0 );
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Issue an asynchronous write at the given file offset
+
+bool File::WriteAsync( uint64_t offset, const void* pBuffer, uint32_t bytes, 
+                       AsyncRequest& request )
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  assert( flags_ & FileFlags::Async );
+  assert( pBuffer != nullptr );
+  assert( bytes > 0 );
+  assert( !request.IsPending() );
+
+  request.Begin( *this, offset, bytes, true );
+  auto pControl = reinterpret_cast<aiocb*>( request.native_ );
+  pControl->aio_buf = const_cast<void*>( pBuffer ); // never written through
+  if( ::aio_write( pControl ) == 0 )
+    return true;
+
+  request.Complete( false, 0 );
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Preferred I/O block size of the file system; the alignment used for
+// unbuffered (O_DIRECT) I/O
+
+uint32_t File::GetSectorSize() const
+{
+  assert( IsOpen() );
+  constexpr uint32_t kDefaultSectorSize = 4096;
+  struct stat st = {};
+  if( ::fstat( ToFd( file_ ), &st ) != 0 )
+    return kDefaultSectorSize;
+
+  auto sectorSize = static_cast<uint32_t>( st.st_blksize );
+  if( sectorSize < 512 || ( sectorSize & ( sectorSize - 1 ) ) != 0 )
+    return kDefaultSectorSize;
+  return sectorSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Flush file to storage medium
+
+bool File::Flush() const
+{
+  assert( path_.has_filename() );
+  assert( IsOpen() );
+  FileStats::Timer timer( stats_, FileOp::Flush );
+  auto success = ( ::fsync( ToFd( file_ ) ) == 0 );
+  timer.Done( path_, 0, success );
+  if( !success )
+    PKLOG_WARN( "fsync failed for %s with error %d\n", path_.c_str(), errno );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Delete the file or directory, including directory contents. Requires that
+// the file is closed. POSIX has no recycle bin, so files are always deleted
+// permanently.
+
+bool File::Delete( bool ) const
+{
+  assert( !IsOpen() );
+  if( IsOpen() )
+    return false;
+
+  FileStats::Timer timer( stats_, FileOp::Delete );
+  auto success = ( ::unlink( path_.c_str() ) == 0 );
+  if( !success )
+  {
+    std::error_code ec;
+    success = ( fs::remove_all( path_, ec ) > 0 && !ec );
+  }
+  timer.Done( path_, 0, success );
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Delete many files or directories. Returns true if everything was deleted.
+
+bool File::DeleteFiles( std::span<const fs::path> paths, bool recycle )
+{
+  auto success = true;
+  for( const auto& path : paths )
+    success = File( path ).Delete( recycle ) && success;
+  return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Map [offset, offset + length) of the file into memory. Length is clamped to
+// the end of the file. Fails for empty ranges, as on Windows. Unmaps any
+// existing view.
+
+bool File::MapView::Map( const File& file, uint64_t offset, uint64_t length )
+{
+  assert( file.IsOpen() );
+  Unmap();
+
+  auto fileLen = file.GetLength();
+  if( offset >= fileLen )
+    return false;
+  length = std::min( length, fileLen - offset );
+
+  // View must begin on a page boundary
+  uint64_t granularity = static_cast<uint64_t>( ::sysconf( _SC_PAGESIZE ) );
+  uint64_t viewStart = offset - ( offset % granularity );
+  uint64_t viewLen = length + ( offset - viewStart );
+  if( viewLen > std::numeric_limits<size_t>::max() )
+    return false;
+
+  auto view = ::mmap( nullptr, static_cast<size_t>( viewLen ), PROT_READ, MAP_SHARED, 
+                      ToFd( file.file_ ), static_cast<off_t>( viewStart ) );
+  if( view == MAP_FAILED )
+  {
+    PKLOG_WARN( "mmap failed to map file %s with error %d\n", file.path_.c_str(), errno );
+    return false;
+  }
+
+  view_ = view;
+  auto first = static_cast<const std::byte*>( view_ ) + ( offset - viewStart );
+  data_ = { first, static_cast<size_t>( length ) };
+  return true;
+}
+
+bool File::MapView::Prefetch( size_t offset, size_t length ) const
+{
+  assert( IsMapped() );
+  if( offset >= data_.size() )
+    return true;
+  length = std::min( length, data_.size() - offset );
+
+  // madvise requires a page-aligned start
+  auto pageSize = static_cast<uintptr_t>( ::sysconf( _SC_PAGESIZE ) );
+  auto first = reinterpret_cast<uintptr_t>( data_.data() + offset );
+  auto start = first - ( first % pageSize );
+  if( ::madvise( reinterpret_cast<void*>( start ), length + ( first - start ), MADV_WILLNEED ) == 0 )
+    return true;
+  PKLOG_WARN( "madvise failed with error %d\n", errno );
+  return false;
+}
+
+void File::MapView::Unmap()
+{
+  if( view_ != nullptr )
+  {
+    auto viewLen = static_cast<size_t>( data_.data() - static_cast<const std::byte*>( view_ ) ) + 
+                   data_.size();
+    [[maybe_unused]] auto result = ::munmap( view_, viewLen );
+    assert( result == 0 );
+    view_ = nullptr;
+    data_ = {};
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AsyncRequest
+
+File::AsyncRequest::AsyncRequest() :
+  native_(),
+  event_( nullptr ),
+  file_( FromFd( kInvalidFd ) ),
+  stats_( nullptr ),
+  path_(),
+  start_(),
+  bytesRequested_( 0u ),
+  bytesTransferred_( 0u ),
+  isPending_( false ),
+  success_( false ),
+  isWrite_( false ),
+  isTimed_( false )
+{
+}
+
+File::AsyncRequest::~AsyncRequest()
+{
+  if( isPending_ )
+  {
+    Cancel();
+    Wait();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Prepare the aiocb for a new operation; the caller sets the buffer
+
+void File::AsyncRequest::Begin( const File& file, uint64_t offset, uint32_t bytes, bool isWrite )
+{
+  static_assert( sizeof( aiocb ) <= kNativeSize );
+  static_assert( alignof( aiocb ) <= alignof( std::max_align_t ) );
+
+  auto pControl = new( native_ ) aiocb{};
+  pControl->aio_fildes = ToFd( file.file_ );
+  pControl->aio_offset = static_cast<off_t>( offset );
+  pControl->aio_nbytes = bytes;
+  pControl->aio_sigevent.sigev_notify = SIGEV_NONE;
+
+  file_ = file.file_;
+  stats_ = file.stats_;
+  isWrite_ = isWrite;
+  isTimed_ = ( file.stats_ != nullptr ) || FileStats::IsEnabled();
+  if( isTimed_ )
+  {
+    path_ = file.path_;
+    start_ = std::chrono::steady_clock::now();
+  }
+  bytesRequested_ = bytes;
+  bytesTransferred_ = 0u;
+  isPending_ = true;
+  success_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Poll for completion without blocking. Once complete, Wait() returns
+// immediately.
+
+bool File::AsyncRequest::IsComplete() const
+{
+  if( !isPending_ )
+    return true;
+  auto pControl = reinterpret_cast<const aiocb*>( native_ );
+  return( ::aio_error( pControl ) != EINPROGRESS );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Block until the operation completes; returns bytesTransferred, which may be
+// short for reads that reach the end of the file
+
+bool File::AsyncRequest::Wait( uint32_t& bytesTransferred )
+{
+  if( isPending_ )
+  {
+    auto pControl = reinterpret_cast<aiocb*>( native_ );
+    const aiocb* controls[] = { pControl };
+    int error = 0;
+    while( ( error = ::aio_error( pControl ) ) == EINPROGRESS )
+      ::aio_suspend( controls, 1, nullptr );
+
+    auto result = ::aio_return( pControl );
+    auto success = ( error == 0 && result >= 0 );
+    Complete( success, success ? static_cast<uint32_t>( result ) : 0u );
+  }
+  bytesTransferred = bytesTransferred_;
+  return success_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Request cancellation of a pending operation. Wait() must still be called;
+// a cancelled operation may have completed anyway.
+
+void File::AsyncRequest::Cancel()
+{
+  if( isPending_ )
+  {
+    auto pControl = reinterpret_cast<aiocb*>( native_ );
+    ::aio_cancel( ToFd( file_ ), pControl );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Atomically replace target with source; source no longer exists afterwards.
+// Target need not exist. The directory is flushed so the rename itself
+// survives a crash. Both must be on the same file system.
+
+bool File::Replace( const fs::path& source, const fs::path& target )
+{
+  if( ::rename( source.c_str(), target.c_str() ) != 0 )
+  {
+    PKLOG_WARN( "rename failed to replace file %s with error %d\n", target.c_str(), errno );
+    return false;
+  }
+
+  auto dir = target.has_parent_path() ? target.parent_path() : fs::path( "." );
+  auto dirFd = OpenFd( dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+  if( dirFd != kInvalidFd )
+  {
+    ::fsync( dirFd );
+    ::close( dirFd );
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // !_WIN32
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileStats.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <bit>
+#include "FileStats.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+std::atomic<FileStats::TraceHook> sTraceHook = nullptr;
+std::atomic<void*> sTraceContext = nullptr;
+
+} // end anonymous namespace
+
+std::atomic<bool> FileStats::sIsEnabled = false;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Counters are independent relaxed atomics. A snapshot taken while I/O is
+// running may be mid-update across counters but never tears a counter.
+
+void FileStats::Record( FileOp op, uint64_t bytes, uint64_t nanoseconds, bool success )
+{
+  auto& counters = ops_[ static_cast<size_t>( op ) ];
+  counters.calls.fetch_add( 1, std::memory_order_relaxed );
+  if( !success )
+    counters.failures.fetch_add( 1, std::memory_order_relaxed );
+  counters.bytes.fetch_add( bytes, std::memory_order_relaxed );
+  counters.totalNanoseconds.fetch_add( nanoseconds, std::memory_order_relaxed );
+
+  auto max = counters.maxNanoseconds.load( std::memory_order_relaxed );
+  while( nanoseconds > max && 
+         !counters.maxNanoseconds.compare_exchange_weak( max, nanoseconds, std::memory_order_relaxed ) )
+  {
+  }
+
+  auto bucket = std::min<size_t>( static_cast<size_t>( std::bit_width( nanoseconds ) ), kBucketCount - 1 );
+  counters.latency[ bucket ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+FileStats::Snapshot FileStats::GetSnapshot() const
+{
+  Snapshot snapshot;
+  for( size_t i = 0; i < kFileOpCount; ++i )
+  {
+    const auto& counters = ops_[ i ];
+    auto& result = snapshot.ops[ i ];
+    result.calls = counters.calls.load( std::memory_order_relaxed );
+    result.failures = counters.failures.load( std::memory_order_relaxed );
+    result.bytes = counters.bytes.load( std::memory_order_relaxed );
+    result.totalNanoseconds = counters.totalNanoseconds.load( std::memory_order_relaxed );
+    result.maxNanoseconds = counters.maxNanoseconds.load( std::memory_order_relaxed );
+    for( size_t b = 0; b < kBucketCount; ++b )
+      result.latency[ b ] = counters.latency[ b ].load( std::memory_order_relaxed );
+  }
+  return snapshot;
+}
+
+void FileStats::Reset()
+{
+  for( auto& counters : ops_ )
+  {
+    counters.calls.store( 0, std::memory_order_relaxed );
+    counters.failures.store( 0, std::memory_order_relaxed );
+    counters.bytes.store( 0, std::memory_order_relaxed );
+    counters.totalNanoseconds.store( 0, std::memory_order_relaxed );
+    counters.maxNanoseconds.store( 0, std::memory_order_relaxed );
+    for( auto& bucket : counters.latency )
+      bucket.store( 0, std::memory_order_relaxed );
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Global controls
+
+FileStats& FileStats::GetGlobal()
+{
+  static FileStats sGlobal;
+  return sGlobal;
+}
+
+void FileStats::Enable( bool isEnabled )
+{
+  sIsEnabled.store( isEnabled, std::memory_order_relaxed );
+}
+
+void FileStats::SetTraceHook( TraceHook hook, void* context )
+{
+  // Context first, so a hook that's seen always has its context
+  sTraceContext.store( context, std::memory_order_relaxed );
+  sTraceHook.store( hook, std::memory_order_release );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Fan one finished operation out to everything watching
+
+void FileStats::Done( FileStats* fileStats, FileOp op, const fs::path& path, 
+                      uint64_t bytes, uint64_t nanoseconds, bool success )
+{
+  if( fileStats != nullptr )
+    fileStats->Record( op, bytes, nanoseconds, success );
+  if( IsEnabled() )
+    GetGlobal().Record( op, bytes, nanoseconds, success );
+  auto hook = sTraceHook.load( std::memory_order_acquire );
+  if( hook != nullptr )
+    hook( sTraceContext.load( std::memory_order_relaxed ), op, path, bytes, nanoseconds, success );
+}
+
+///////////////////////////////////////////////////////////////////////////////
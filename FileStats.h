@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileStats.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Optional I/O instrumentation. Counts calls, failures and bytes per operation,
+//  with a log2 latency histogram, into process-wide counters and optionally a
+//  per-File FileStats. Recording is off until enabled; while off, File pays a
+//  single relaxed atomic load per operation. A trace hook receives every
+//  recorded operation, e.g. to emit ETW or other trace events.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace PKIsensee
+{
+
+enum class FileOp : uint32_t
+{
+  Open,
+  Create,
+  Read,
+  Write,
+  Flush,
+  Delete,
+};
+
+constexpr size_t kFileOpCount = 6;
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileStats
+{
+public:
+
+  // Bucket 0 holds zero-latency operations; bucket b holds latencies in
+  // [2^(b-1), 2^b) nanoseconds. The last bucket holds everything slower.
+  static constexpr size_t kBucketCount = 40;
+
+  struct OpCounts
+  {
+    uint64_t calls = 0u;
+    uint64_t failures = 0u;
+    uint64_t bytes = 0u;
+    uint64_t totalNanoseconds = 0u;
+    uint64_t maxNanoseconds = 0u;
+    std::array<uint64_t, kBucketCount> latency = {};
+  };
+
+  struct Snapshot
+  {
+    std::array<OpCounts, kFileOpCount> ops = {};
+
+    const OpCounts& operator[]( FileOp op ) const {
+      return ops[ static_cast<size_t>( op ) ];
+    }
+  };
+
+  // Invoked for every recorded operation, on the thread that performed it.
+  // Path is that of the File, which may be empty.
+  using TraceHook = void (*)( void* context, FileOp, const std::filesystem::path&,
+                              uint64_t bytes, uint64_t nanoseconds, bool success );
+
+public:
+
+  FileStats() = default;
+  ~FileStats() = default;
+
+  // Disable copy/move; Files refer to their stats by address
+  FileStats( const FileStats& ) = delete;
+  FileStats& operator=( const FileStats& ) = delete;
+  FileStats( FileStats&& ) = delete;
+  FileStats& operator=( FileStats&& ) = delete;
+
+  void Record( FileOp, uint64_t bytes, uint64_t nanoseconds, bool success );
+  Snapshot GetSnapshot() const;
+  void Reset();
+
+  // Process-wide counters, recorded into by every File while enabled. Per-File
+  // stats set with File::SetStats record regardless.
+  static FileStats& GetGlobal();
+  static void Enable( bool isEnabled = true );
+  static bool IsEnabled() {
+    return sIsEnabled.load( std::memory_order_relaxed );
+  }
+
+  // Set before I/O starts; nullptr removes the hook
+  static void SetTraceHook( TraceHook, void* context = nullptr );
+
+  ///////////////////////////////////////////////////////////////////////////////
+  //
+  // Times one operation. Reads the clock only if something will record it.
+
+  class Timer
+  {
+  public:
+
+    Timer( FileStats* fileStats, FileOp op ) :
+      fileStats_( fileStats ),
+      op_( op ),
+      isActive_( fileStats != nullptr || IsEnabled() ),
+      start_( isActive_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point() )
+    {
+    }
+
+    // Disable copy/move
+    Timer( const Timer& ) = delete;
+    Timer& operator=( const Timer& ) = delete;
+    Timer( Timer&& ) = delete;
+    Timer& operator=( Timer&& ) = delete;
+
+    bool IsActive() const {
+      return isActive_;
+    }
+
+    void Done( const std::filesystem::path& path, uint64_t bytes, bool success ) const
+    {
+      if( isActive_ )
+        FileStats::Done( fileStats_, op_, path, bytes, Elapsed( start_ ), success );
+    }
+
+    static uint64_t Elapsed( std::chrono::steady_clock::time_point start )
+    {
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() );
+    }
+
+  private:
+
+    FileStats*                            fileStats_;
+    FileOp                                op_;
+    bool                                  isActive_;
+    std::chrono::steady_clock::time_point start_;
+
+  }; // class Timer
+
+  // Record into the per-File and global stats and invoke the trace hook
+  static void Done( FileStats* fileStats, FileOp, const std::filesystem::path&, 
+                    uint64_t bytes, uint64_t nanoseconds, bool success );
+
+private:
+
+  struct Counters
+  {
+    std::atomic<uint64_t> calls = 0u;
+    std::atomic<uint64_t> failures = 0u;
+    std::atomic<uint64_t> bytes = 0u;
+    std::atomic<uint64_t> totalNanoseconds = 0u;
+    std::atomic<uint64_t> maxNanoseconds = 0u;
+    std::array<std::atomic<uint64_t>, kBucketCount> latency = {};
+  };
+
+  static std::atomic<bool> sIsEnabled;
+
+  std::array<Counters, kFileOpCount> ops_;
+
+}; // class FileStats
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileTask.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Lazily started coroutine task used by the awaitable FileIoScheduler calls.
+//  A task runs when first awaited, and resumes its awaiter when it completes.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cassert>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Coroutine returning T. Awaiting the task starts it; the awaiting coroutine
+// resumes on whichever thread finishes the task. Wait() runs a task from
+// ordinary code, blocking the calling thread.
+//
+//   FileTask<bool> LoadLevel( FileIoScheduler& scheduler, Level& level )
+//   {
+//     if( !co_await scheduler.ReadEntireFileAsync( level.path, level.data ) )
+//       co_return false;
+//     co_return level.Parse();
+//   }
+
+template <class T>
+class FileTask
+{
+public:
+
+  struct promise_type
+  {
+    std::optional<T>        value;
+    std::coroutine_handle<> continuation;
+
+    // Set by Wait()
+    std::mutex*              pMutex = nullptr;
+    std::condition_variable* pDone = nullptr;
+    bool*                    pIsDone = nullptr;
+
+    FileTask get_return_object() {
+      return FileTask( std::coroutine_handle<promise_type>::from_promise( *this ) );
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    // Hand the thread straight to the awaiter, or signal Wait()
+    auto final_suspend() noexcept
+    {
+      struct FinalAwaiter
+      {
+        bool await_ready() noexcept {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend( std::coroutine_handle<promise_type> handle ) noexcept
+        {
+          auto& promise = handle.promise();
+          if( promise.continuation )
+            return promise.continuation;
+          if( promise.pDone != nullptr )
+          {
+            std::lock_guard lock( *promise.pMutex );
+            *promise.pIsDone = true;
+            promise.pDone->notify_one();
+          }
+          return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+
+    void return_value( T result ) {
+      value = std::move( result );
+    }
+
+    // File reports errors through results, not exceptions
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+
+public:
+
+  FileTask( FileTask&& rhs ) noexcept :
+    handle_( std::exchange( rhs.handle_, nullptr ) )
+  {
+  }
+
+  FileTask& operator=( FileTask&& rhs ) noexcept
+  {
+    if( this != &rhs )
+    {
+      if( handle_ )
+        handle_.destroy();
+      handle_ = std::exchange( rhs.handle_, nullptr );
+    }
+    return *this;
+  }
+
+  ~FileTask()
+  {
+    if( handle_ )
+      handle_.destroy();
+  }
+
+  // Disable copy
+  FileTask( const FileTask& ) = delete;
+  FileTask& operator=( const FileTask& ) = delete;
+
+  bool await_ready() const noexcept {
+    return !handle_ || handle_.done();
+  }
+
+  std::coroutine_handle<> await_suspend( std::coroutine_handle<> awaiter ) noexcept
+  {
+    handle_.promise().continuation = awaiter;
+    return handle_;
+  }
+
+  T await_resume()
+  {
+    assert( handle_ && handle_.promise().value );
+    return std::move( *handle_.promise().value );
+  }
+
+  // Run the task to completion from a thread that isn't a coroutine. Don't
+  // call on a thread the task needs in order to finish, e.g. an I/O worker.
+  T Wait()
+  {
+    assert( handle_ && !handle_.done() );
+    std::mutex mutex;
+    std::condition_variable done;
+    auto isDone = false;
+    auto& promise = handle_.promise();
+    promise.pMutex = &mutex;
+    promise.pDone = &done;
+    promise.pIsDone = &isDone;
+
+    handle_.resume();
+    std::unique_lock lock( mutex );
+    done.wait( lock, [&] { return isDone; } );
+    return std::move( *promise.value );
+  }
+
+private:
+
+  explicit FileTask( std::coroutine_handle<promise_type> handle ) :
+    handle_( handle )
+  {
+  }
+
+private:
+
+  std::coroutine_handle<promise_type> handle_;
+
+}; // class FileTask
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
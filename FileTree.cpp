@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileTree.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FileTree.h"
+
+using namespace PKIsensee;
+namespace fs = std::filesystem;
+
+namespace { // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Each worker owns a deque of directories to enumerate. Owners push and pop
+// at the back, keeping their walk depth first; idle workers steal from the
+// front, taking the shallowest (and likely largest) subtrees.
+
+class Walker
+{
+public:
+
+  Walker( const FileTree::Callback& callback, uint32_t threadCount ) :
+    callback_( callback ),
+    queues_( threadCount )
+  {
+  }
+
+  // Disable copy/move
+  Walker( const Walker& ) = delete;
+  Walker& operator=( const Walker& ) = delete;
+  Walker( Walker&& ) = delete;
+  Walker& operator=( Walker&& ) = delete;
+
+  bool Run( const fs::path& root )
+  {
+    Push( 0, root );
+    std::vector<std::thread> threads;
+    threads.reserve( queues_.size() - 1 );
+    for( size_t i = 1; i < queues_.size(); ++i )
+      threads.emplace_back( &Walker::WorkerThread, this, i );
+    WorkerThread( 0 );
+    for( auto& thread : threads )
+      thread.join();
+    return !hasError_;
+  }
+
+private:
+
+  struct Queue
+  {
+    std::mutex            mutex;
+    std::deque<fs::path>  dirs;
+  };
+
+  void WorkerThread( size_t self )
+  {
+    fs::path dir;
+    for( ;; )
+    {
+      // Sample the signal before looking for work so a push made after a
+      // failed search is never missed
+      auto signal = signal_.load();
+      if( Pop( self, dir ) || Steal( self, dir ) )
+      {
+        Enumerate( self, dir );
+        if( --pending_ == 0 )
+          Signal();
+        continue;
+      }
+      if( pending_ == 0 )
+        return;
+      signal_.wait( signal );
+    }
+  }
+
+  void Enumerate( size_t self, const fs::path& dir )
+  {
+    auto success = File::EnumerateDirectory( dir, [&]( const File::DirEntry& entry )
+    {
+      // Links aren't followed; they can form cycles
+      if( callback_( entry ) && entry.isDirectory && !entry.isLink )
+        Push( self, entry.path );
+      return true;
+    } );
+    if( !success )
+      hasError_ = true;
+  }
+
+  void Push( size_t self, const fs::path& dir )
+  {
+    ++pending_;
+    {
+      std::lock_guard lock( queues_[ self ].mutex );
+      queues_[ self ].dirs.push_back( dir );
+    }
+    Signal();
+  }
+
+  bool Pop( size_t self, fs::path& dir )
+  {
+    auto& queue = queues_[ self ];
+    std::lock_guard lock( queue.mutex );
+    if( queue.dirs.empty() )
+      return false;
+    dir = std::move( queue.dirs.back() );
+    queue.dirs.pop_back();
+    return true;
+  }
+
+  bool Steal( size_t self, fs::path& dir )
+  {
+    for( size_t i = 1; i < queues_.size(); ++i )
+    {
+      auto& victim = queues_[ ( self + i ) % queues_.size() ];
+      std::lock_guard lock( victim.mutex );
+      if( !victim.dirs.empty() )
+      {
+        dir = std::move( victim.dirs.front() );
+        victim.dirs.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Signal()
+  {
+    ++signal_;
+    signal_.notify_all();
+  }
+
+private:
+
+  const FileTree::Callback& callback_;
+  std::vector<Queue>        queues_;
+  std::atomic<size_t>       pending_ = 0;  // directories queued or being enumerated
+  std::atomic<uint32_t>     signal_ = 0;   // bumped on new work and on completion
+  std::atomic<bool>         hasError_ = false;
+
+}; // class Walker
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Visit every entry below root
+
+bool FileTree::Walk( const fs::path& root, const Callback& callback, uint32_t threadCount )
+{
+  if( threadCount == 0 )
+    threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+  Walker walker( callback, threadCount );
+  return walker.Run( root );
+}
+
+///////////////////////////////////////////////////////////////////////////////
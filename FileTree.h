@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  FileTree.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Parallel traversal of a directory hierarchy. Directories are spread over a
+//  pool of threads with work stealing; per-entry metadata comes from the
+//  directory listing itself (File::EnumerateDirectory).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <functional>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+
+class FileTree
+{
+public:
+
+  // Invoked concurrently from multiple threads for every entry below the root,
+  // in no particular order. Return false for a directory to skip its contents.
+  using Callback = std::function<bool( const File::DirEntry& )>;
+
+  // Zero threads uses one per hardware thread. Returns false if any directory
+  // couldn't be read; the rest of the tree is still visited.
+  static bool Walk( const std::filesystem::path& root, const Callback&, 
+                    uint32_t threadCount = 0 );
+
+}; // class FileTree
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  LineReader.cpp
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//  LineReader; portable, with SSE2 scanning on x86 and x64
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <bit>
+#include <cstring>
+#include "LineReader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define PK_LINEREADER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace PKIsensee;
+
+namespace { // anonymous namespace
+
+constexpr size_t kScanWidth = 16;
+
+// Bit i is set if p[i] == c, for the kScanWidth bytes at p
+uint32_t MatchMask( const char* p, char c )
+{
+#if defined(PK_LINEREADER_SSE2)
+  auto bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+  auto matches = _mm_cmpeq_epi8( bytes, _mm_set1_epi8( c ) );
+  return static_cast<uint32_t>( _mm_movemask_epi8( matches ) );
+#else
+  uint32_t mask = 0u;
+  for( size_t i = 0; i < kScanWidth; ++i )
+    mask |= uint32_t( p[ i ] == c ) << i;
+  return mask;
+#endif
+}
+
+std::string_view TrimCarriageReturn( std::string_view line )
+{
+  if( !line.empty() && line.back() == '\r' )
+    line.remove_suffix( 1 );
+  return line;
+}
+
+} // end anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Ctors
+
+LineReader::LineReader( std::string_view text ) :
+  chunks_( nullptr ),
+  chunk_(),
+  carry_(),
+  pos_( nullptr ),
+  scan_( nullptr ),
+  end_( nullptr ),
+  maskBase_( nullptr ),
+  mask_( 0u ),
+  isCarryLine_( false )
+{
+  SetInput( text );
+}
+
+LineReader::LineReader( std::span<const std::byte> data ) :
+  LineReader( std::string_view( reinterpret_cast<const char*>( data.data() ), data.size() ) )
+{
+}
+
+LineReader::LineReader( File::ChunkRange& chunks ) :
+  LineReader( std::string_view() )
+{
+  chunks_ = &chunks;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Take lines from the current input until it runs out of newlines. With
+// chunked input, the unterminated remainder is carried into the next chunk.
+
+bool LineReader::Next( std::string_view& line )
+{
+  if( isCarryLine_ )
+  {
+    carry_.clear();
+    isCarryLine_ = false;
+  }
+
+  for( ;; )
+  {
+    if( auto pNewline = FindNewline() )
+    {
+      line = std::string_view( pos_, size_t( pNewline - pos_ ) );
+      pos_ = pNewline + 1;
+      if( !carry_.empty() )
+      {
+        carry_.append( line );
+        line = carry_;
+        isCarryLine_ = true;
+      }
+      line = TrimCarriageReturn( line );
+      return true;
+    }
+
+    // Unterminated remainder
+    std::string_view rest( pos_, size_t( end_ - pos_ ) );
+    pos_ = end_;
+    if( chunks_ == nullptr )
+    {
+      if( rest.empty() )
+        return false;
+      line = TrimCarriageReturn( rest );
+      return true;
+    }
+    carry_.append( rest );
+    if( !NextChunk() )
+    {
+      if( carry_.empty() )
+        return false;
+      line = TrimCarriageReturn( carry_ );
+      isCarryLine_ = true;
+      return true;
+    }
+  }
+}
+
+bool LineReader::HasError() const
+{
+  return chunks_ != nullptr && chunks_->HasError();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Scan kScanWidth bytes at a time, keeping the newline mask of the last block
+// scanned so each block is loaded once however many lines it holds
+
+const char* LineReader::FindNewline()
+{
+  for( ;; )
+  {
+    if( mask_ != 0 )
+    {
+      auto pNewline = maskBase_ + std::countr_zero( mask_ );
+      mask_ &= mask_ - 1;
+      return pNewline;
+    }
+    if( size_t( end_ - scan_ ) < kScanWidth )
+      break;
+    mask_ = MatchMask( scan_, '\n' );
+    maskBase_ = scan_;
+    scan_ += kScanWidth;
+  }
+
+  // Tail shorter than a block
+  if( scan_ == end_ )
+    return nullptr;
+  auto pNewline = static_cast<const char*>( std::memchr( scan_, '\n', size_t( end_ - scan_ ) ) );
+  scan_ = pNewline ? pNewline + 1 : end_;
+  return pNewline;
+}
+
+bool LineReader::NextChunk()
+{
+  if( !chunk_ )
+    chunk_ = chunks_->begin();
+  else
+    ++*chunk_;
+  if( *chunk_ == chunks_->end() )
+    return false;
+  auto chunk = **chunk_;
+  SetInput( std::string_view( reinterpret_cast<const char*>( chunk.data() ), chunk.size() ) );
+  return true;
+}
+
+void LineReader::SetInput( std::string_view text )
+{
+  pos_ = text.data();
+  scan_ = text.data();
+  end_ = text.data() + text.size();
+  maskBase_ = text.data();
+  mask_ = 0u;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Same block scan as FindNewline, for the separator
+
+size_t LineReader::Split( std::string_view line, char separator, 
+                          std::span<std::string_view> fields )
+{
+  auto p = line.data();
+  auto end = p + line.size();
+  auto fieldStart = p;
+  size_t count = 0u;
+  auto addField = [&]( const char* fieldEnd )
+  {
+    if( count < fields.size() )
+      fields[ count ] = std::string_view( fieldStart, size_t( fieldEnd - fieldStart ) );
+    ++count;
+    fieldStart = fieldEnd + 1;
+  };
+
+  for( ; size_t( end - p ) >= kScanWidth; p += kScanWidth )
+  {
+    for( auto mask = MatchMask( p, separator ); mask != 0; mask &= mask - 1 )
+      addField( p + std::countr_zero( mask ) );
+  }
+  for( ; p < end; ++p )
+  {
+    if( *p == separator )
+      addField( p );
+  }
+  addField( end );
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  LineReader.h
+//
+//  Copyright  Pete Isensee (PKIsensee@msn.com).
+//  All rights reserved worldwide.
+//
+//  Permission to copy, modify, reproduce or redistribute this source code is
+//  granted provided the above copyright notice is retained in the resulting 
+//  source code.
+// 
+//  This software is provided "as is" and without any express or implied
+//  warranties.
+// 
+//-----------------------------------------------------------------------------
+// 
+//  Splits text into lines, and lines into fields, without copying. Delimiters
+//  are found 16 bytes at a time with SSE2 where available.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "File.h"
+
+namespace PKIsensee
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Yields the lines of a buffer, e.g. a MapView, or of a ChunkRange. Lines end
+// at '\n'; a trailing '\r' is dropped, and so is an empty line after the final
+// '\n'. Views point into the input, except lines that straddle two chunks,
+// which are assembled in an internal buffer. A view is valid until the next
+// call to Next(), or for buffer input as long as the buffer.
+//
+//   File::MapView view;
+//   view.Map( file );
+//   LineReader reader( view.GetData() );
+//   for( std::string_view line; reader.Next( line ); )
+//     Process( line );
+
+class LineReader
+{
+public:
+
+  explicit LineReader( std::string_view );
+  explicit LineReader( std::span<const std::byte> );
+  explicit LineReader( File::ChunkRange& );
+
+  // Disable copy/move
+  LineReader( const LineReader& ) = delete;
+  LineReader& operator=( const LineReader& ) = delete;
+  LineReader( LineReader&& ) = delete;
+  LineReader& operator=( LineReader&& ) = delete;
+
+  // Returns false after the last line
+  bool Next( std::string_view& line );
+
+  // True if chunked input stopped because a read failed rather than at EOF
+  bool HasError() const;
+
+  // Split a line at separator, e.g. ',' for simple CSV without quoting.
+  // Returns the number of fields, which may exceed fields.size(); only the
+  // first fields.size() are stored.
+  static size_t Split( std::string_view line, char separator, 
+                       std::span<std::string_view> fields );
+
+private:
+
+  const char* FindNewline();
+  bool NextChunk();
+  void SetInput( std::string_view );
+
+private:
+
+  File::ChunkRange*                          chunks_;
+  std::optional<File::ChunkRange::Iterator>  chunk_;
+  std::string                                carry_;       // line straddling chunks
+  const char*                                pos_;         // start of the next line
+  const char*                                scan_;        // next byte to scan
+  const char*                                end_;
+  const char*                                maskBase_;    // address of mask_ bit 0
+  uint32_t                                   mask_;        // newlines found, not yet consumed
+  bool                                       isCarryLine_; // last line came from carry_
+
+}; // class LineReader
+
+} // end namespace PKIsensee
+
+///////////////////////////////////////////////////////////////////////////////